@@ -19,9 +19,33 @@
 #include <stdint.h>		// uint32_t
 #include <libgen.h>		// basename()
 #include <math.h>		// round()
+#include <fcntl.h>		// open()
+#include <stddef.h>		// offsetof()
+#include <pthread.h>		// tsdump worker threads
+#include <sys/mman.h>		// mmap(), madvise()
+#include <sys/stat.h>		// fstat()
+#include <sys/resource.h>	// getrusage(), for --stats
+#include <getopt.h>		// getopt_long(), for --stats
+#include "ts.h"			// the libts interface, implemented at the end of this file
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>		// SSSE3 and AVX2 byte shuffles
+#define HAVE_X86_SIMD 1
+#endif
 
 typedef uint32_t fourcc ;	// four bytes that are subject to byte swapping
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_LITTLE_ENDIAN 0
+#else
+#define HOST_LITTLE_ENDIAN 1		// the binary file is big endian, so values are swapped on this host
+#endif
+
+#if defined(__APPLE__)
+#define STAT_MTIME_NSEC(st)	((st)->st_mtimespec.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st)	((st)->st_mtim.tv_nsec)
+#endif
+
 // declare a node for the linked list
 struct node
 {
@@ -116,6 +140,61 @@ struct config
 	// scaling information
 	double scalar_one ;			// scaling value for I
 	double scalar_two ;			// scaling value for Q
+	// text format
+	int compact ;				// alvl samples are written as integer counts
+} ;
+
+struct arena_chunk						// one piece of memory that arena allocations are carved from
+{
+	struct arena_chunk *next ;				// the chunk that was current before this one
+	size_t size ;						// bytes available after the chunk header
+	size_t used ;						// bytes handed out so far
+	size_t last ;						// offset of the most recent allocation, so it can grow in place
+} ;
+
+struct arena							// a bump allocator, everything is released at once
+{
+	struct arena_chunk *chunk ;				// the current chunk, earlier chunks are linked behind it
+	size_t chunk_size ;					// the usual size of a new chunk
+} ;
+
+#define STATS_READ	0		// the phases --stats times
+#define STATS_PARSE	1
+#define STATS_FIXUP	2
+#define STATS_FORMAT	3
+#define STATS_WRITE	4
+#define STATS_PHASES	5
+
+struct run_stats						// what --stats reports, only ever updated by the main thread
+{
+	struct config counts ;					// the block counters, nothing else in it is used
+	double wall[STATS_PHASES] ;				// seconds spent in each phase
+	double cpu[STATS_PHASES] ;				// process cpu seconds during each phase, all threads included
+	double wall_start ;					// when the program started
+	double cpu_start ;
+	uint64_t bytes_in ;
+	uint64_t bytes_out ;
+	char *jsonname ;					// the report goes here as JSON, or to stderr as text if NULL
+} ;
+
+struct stats_clock						// the start of one timed stretch of a phase
+{
+	double wall ;
+	double cpu ;
+} ;
+
+struct parse_context						// owns everything allocated while parsing or generating one file
+{
+	struct arena nodes ;					// list nodes and small data blocks
+	struct arena slabs ;					// alvl payloads, packed into large slabs
+	struct run_stats *stats ;				// counts the blocks parsed and times their fixup, NULL if not wanted
+	struct config config ;					// the bin_type of the last fbin block parsed, alvl blocks are fixed up with it
+} ;
+
+struct parse_state						// parse_block() turning ts_events into nodes
+{
+	struct parse_context *context ;
+	struct node *tail ;					// the last node linked so far
 } ;
 
 struct block_header
@@ -124,47 +203,472 @@ struct block_header
 	uint32_t size ;
 } __attribute__((packed)) ;	// disable padding to make the header line up with the file data
 
+struct text_reader						// buffered line reader for tsgen, the text file is read once front to back
+{
+	FILE *fd ;						// the text file
+	char *buffer ;						// read buffer, lines are returned in place
+	size_t buffer_size ;					// allocated size of buffer, not counting a spare byte for a terminator
+	size_t start ;						// offset of the first unread character
+	size_t end ;						// offset just past the last character read from the file
+	int eof ;						// set once fread() returns nothing
+	long line_count ;					// number of lines returned so far
+	char *block ;						// the parameter lines of the current block, each terminated by '\0'
+	size_t block_length ;					// bytes used in block
+	size_t block_size ;					// allocated size of block
+	size_t alvl_capacity ;					// samples allocated for the largest alvl block so far, used as a first guess
+} ;
+
+struct gen_item							// one block of text on its way to the binary file, in a ring shared by tsgen and its workers
+{
+	size_t sequence ;					// position in the output
+	int job ;						// 1 for an alvl block left to a worker, 0 for a block made by the reading thread
+	int done ;						// set once the block's node is made
+	int err ;
+	long line_count ;					// line of the block key, for error messages
+	struct config config ;					// the bin_type and scal values an alvl block is scaled with
+	struct text_reader reader ;				// the lines of an alvl block, copied out of the text file
+	struct parse_context context ;				// holds the block's node until it is written
+	struct node root ;					// the block's node follows root
+} ;
+
+struct gen_pool							// shared by the tsgen reading thread and its workers, guarded by lock
+{
+	pthread_mutex_t lock ;
+	pthread_cond_t ready ;					// a job is done
+	pthread_cond_t work ;					// a job was added, or stop was set
+	struct gen_item *items ;				// a ring of window items
+	size_t window ;
+	size_t submitted ;					// items handed out by the reading thread
+	size_t written ;					// items written to the binary file
+	size_t next_job ;					// first item the workers have not looked at
+	int stop ;
+} ;
+
+struct power_sum						// running totals for the power of big endian 16 bit samples
+{
+	uint64_t sum_squares ;					// sum of the squared samples
+	int maximum ;						// largest sample, starts at 0
+	int minimum ;						// smallest sample, starts at 0
+	double wide_squares ;					// sum of the squared fix3, fix4 and flt4 samples, which would overflow sum_squares
+	double wide_peak ;					// their largest magnitude
+} ;
+
+struct swap_kernel						// a set of functions that byte swap whole arrays, one set per instruction set
+{
+	char *name ;						// name shown by tsbench
+	int (*supported)(void) ;				// returns 1 if this cpu can run the kernel
+	void (*swap16)(void *, size_t) ;			// byte swaps an array of 16 bit values in place
+	void (*swap24)(void *, size_t) ;			// byte swaps an array of 24 bit values in place
+	void (*swap32)(void *, size_t) ;			// byte swaps an array of 32 bit values in place
+	void (*power16)(const void *, size_t, struct power_sum *) ;	// adds an array of big endian 16 bit values to the power totals
+	void (*unpack16)(const unsigned char *, int, uint16_t *, unsigned char *, size_t) ;	// decodes a group of samples packed by tspack into big endian values
+} ;
+
+struct sample_codec						// how the I and Q values of an alvl block are stored, one per fbin bin_type
+{
+	fourcc bin_type ;
+	int width ;						// bytes per I or Q value
+	int floating ;						// 1 for float values, 0 for signed integer counts
+	double factor ;						// the full scale count that scal values are relative to
+	double full_scale ;					// the magnitude tsstat levels are relative to
+	char *dtype ;						// the NumPy type tsexport writes the counts as
+	void (*load)(const unsigned char *, size_t, double *) ;	// converts an array of values in host order to doubles
+	void (*store)(const double *, size_t, unsigned char *) ;	// converts an array of doubles, whole counts unless floating, to values in host order
+	void (*store_counts)(const int32_t *, size_t, unsigned char *) ;	// the same from integers, for reading compact text, NULL for flt4
+} ;
+
 struct block_functions						// this struct is used to relate a key name with a set of functions
 {
 	fourcc key ;						// a 4 byte block key
-	int (*fixup)(struct node *) ;				// a pointer to a function that is called to perform endian fixup on the data block
-	int (*make)(struct node *, struct config *, FILE *) ;	// a pointer to a function that is called to create a data block from text
+	int (*fixup)(struct node *, struct config *) ;		// a pointer to a function that is called to perform endian fixup on the data block
+	int (*make)(struct parse_context *, struct node *, struct config *, struct text_reader *) ;	// a pointer to a function that is called to create a data block from text
 	int (*dump)(struct node *, struct config *, FILE *) ;	// a pointer to a function that is called to produce text output from a data block
-	int (*gen)(struct node *, FILE *) ;			// a pointer to a function that is called to write out a binary version of the block
+	int (*gen)(struct node *, struct config *, FILE *) ;	// a pointer to a function that is called to write out a binary version of the block
+} ;
+
+struct range							// an inclusive range of numbers
+{
+	uint64_t first ;
+	uint64_t last ;
+} ;
+
+struct range_list						// ranges parsed from text like "1-10,15,20-25"
+{
+	struct range *ranges ;
+	size_t count ;
+	size_t allocated ;
+} ;
+
+struct dump_options						// the tsdump command line options
+{
+	int just_header ;					// stop at the BODY block
+	int streaming ;						// read one block at a time instead of mapping the file
+	int compact ;						// write alvl samples as integer counts, many per line
+	int select ;						// dump only the sweep sets and channels selected below
+	struct range_list sweeps ;				// sweep set positions, counted from 1, all if empty
+	struct range_list indexes ;				// indx values, all if empty
+	struct range_list channels ;				// alvl blocks of a sweep set, counted from 1, all if empty
+	char *infilename ;					// the binary file, to find its index sidecar
+	int threads ;						// threads formatting sweep sets, 1 for the serial dump_list()
+	struct run_stats *stats ;				// --stats, NULL if not given
+} ;
+
+struct export_options						// the tsexport command line options and the shape of the array they select
+{
+	int scaled ;						// complex64 scaled like tsdump writes them, instead of the counts
+	int planar ;						// the I values of each alvl block, then its Q values
+	struct range_list sweeps ;				// sweep set positions, counted from 1, all if empty
+	struct range_list indexes ;				// indx values, all if empty
+	struct range_list channels ;				// alvl blocks of a sweep set, counted from 1, all if empty
+	char *infilename ;					// the binary file
+	char *npyname ;						// the array file
+	size_t *positions ;					// the selected sweep sets, counted from 0
+	size_t count ;						// number of selected sweep sets
+	size_t nchannels ;					// selected alvl blocks in each
+	size_t nsamples ;					// I/Q pairs in each alvl block
+	struct sample_codec *codec ;				// the sample type of the file
+} ;
+
+struct dump_item						// a run of nodes formatted by one tsdump worker, normally one sweep set
+{
+	size_t sequence ;					// position in the output
+	struct node *first ;					// the first node of the run
+	struct node *end ;					// the node after the last one, NULL at the end of the list
+	struct config config ;					// as dumping the nodes in front of first leaves it
+	char *text ;						// the formatted text, from open_memstream()
+	size_t length ;
+	int err ;
+	int done ;						// set by the worker once text is complete
+} ;
+
+struct dump_pool						// shared by the tsdump workers and the writer, guarded by lock
+{
+	pthread_mutex_t lock ;
+	pthread_cond_t ready ;					// an item is done
+	pthread_cond_t space ;					// the writer has freed an item
+	struct dump_item *items ;				// a ring of window items
+	size_t window ;						// how many items may be formatted ahead of the writer
+	size_t next ;						// sequence of the next item to hand out
+	size_t written ;					// items written so far
+	size_t count ;						// number of items, known once cursor reaches the end
+	struct node *cursor ;					// the first node not yet handed out
+	struct config config ;					// as dumping the nodes in front of cursor leaves it
+	int stop ;						// set on error
+} ;
+
+#define INDEX_MAX_CHANNELS	8		// alvl block sizes kept per sweep set
+#define MAX_THREADS		256		// worker threads tsdump will start
+#define SIZE_GEN_CHUNK		4096		// alvl samples byte swapped at a time while writing
+#define SIZE_LOAD_CHUNK		1024		// alvl samples converted to doubles at a time
+#define PACK_GROUP		128		// samples bit packed at the same width
+#define PACK_LANES		8		// sample v of a group goes to lane v%8, so each row of 8 samples is shifted as one 128 bit vector
+
+struct index_header						// the start of a .tsidx sidecar file, in the byte order of the machine that wrote it
+{
+	char magic[8] ;						// INDEX_MAGIC
+	uint32_t byte_order ;					// INDEX_BYTE_ORDER, reads differently on a machine of the other endianness
+	uint32_t entry_size ;					// sizeof(struct index_entry)
+	uint64_t file_size ;					// size of the binary file when the index was built
+	int64_t file_mtime ;					// modification time of the binary file when the index was built
+	int64_t file_mtime_nsec ;				// and its nanoseconds, a file rewritten within the same second at the same size is still stale
+	uint64_t file_inode ;					// inode of the binary file, changes when it is replaced by a rename
+	uint64_t body_offset ;					// file offset of the BODY block header
+	uint64_t end_offset ;					// file offset just past the BODY data
+	uint64_t count ;					// number of entries that follow
+} ;
+
+struct index_entry						// where to find one sweep set and what is in it
+{
+	uint64_t offset ;					// file offset of the first block header of the sweep set
+	uint32_t length ;					// bytes in the sweep set, block headers included
+	uint32_t index ;					// indx value
+	uint32_t gtag ;						// gtag value
+	uint32_t atag ;						// atag value
+	double scalar_one ;					// scal values
+	double scalar_two ;
+	uint32_t nalvl ;					// number of alvl blocks
+	uint32_t alvl_size[INDEX_MAX_CHANNELS] ;		// data size of each alvl block
+} ;
+
+struct sweep_index						// the index of a binary file, loaded from its sidecar or built by walking the block headers
+{
+	struct index_header header ;
+	struct index_entry *entries ;
+	size_t allocated ;					// entries allocated
+} ;
+
+struct pack_header						// the start of a packed file written by tspack, big endian like everything else in it
+{
+	char magic[8] ;						// PACK_MAGIC
+	uint32_t lanes ;					// PACK_LANES, the samples of a group shifted together
+	uint32_t group ;					// PACK_GROUP, samples bit packed at the same width
+	uint64_t file_size ;					// size of the binary file
+	uint64_t head_size ;					// bytes of the binary file up to the first sweep set, AQVL, HEAD and the BODY header, copied as they are
+	uint64_t sets_end ;					// binary file offset just past the last sweep set, the rest of the file is copied as it is
+	uint64_t count ;					// number of sweep sets
+	uint64_t table_offset ;					// packed file offset of the pack_entry table, which ends the file
+} ;
+
+struct pack_entry						// where to find one packed sweep set
+{
+	uint64_t offset ;					// packed file offset of the sweep set
+	uint64_t length ;					// packed bytes
+	uint32_t original_length ;				// bytes in the binary file, block headers included
+	uint32_t index ;					// indx value
+	uint64_t checksum ;					// pack_checksum() of the bytes in the binary file
+} ;
+
+struct pack_block						// in front of the data of each alvl block in a packed sweep set
+{
+	uint32_t method ;					// PACK_RAW or PACK_DELTA
+	uint32_t length ;					// bytes of data that follow
+} ;
+
+struct sweep_stats						// power and scaling of one sweep set, gathered by tsstat
+{
+	uint64_t position ;					// counted from 1
+	uint32_t index ;					// indx value
+	double scalar_one ;					// scal values
+	double scalar_two ;
+	uint32_t nalvl ;					// alvl blocks seen
+	uint64_t npairs[INDEX_MAX_CHANNELS] ;			// I/Q pairs in each alvl block
+	struct power_sum power[INDEX_MAX_CHANNELS] ;		// power totals of each alvl block
+} ;
+
+struct stat_state						// what tsstat carries from one sweep set to the next
+{
+	int list ;						// print every sweep set
+	double threshold ;					// power change in dB that counts as a configuration change, 0 to ignore power
+	struct sweep_stats current ;
+	struct sweep_stats previous ;				// valid once current.position > 1
+	double segment_level ;					// sum of the levels of the sweep sets since the last change
+	uint64_t segment_count ;				// sweep sets since the last change
+	uint64_t segment_start ;				// position of the first sweep set since the last change
+	uint64_t changes ;					// configuration changes found
+	struct sample_codec *codec ;				// the alvl sample type, from the fbin block
+} ;
+
+struct size_patch						// remembers where the superblock headers were written, so tsgen can fill in their sizes at the end
+{
+	long offset_aqlv ;					// file offsets of the AQVL, HEAD and BODY headers, -1 if not written
+	long offset_head ;
+	long offset_body ;
+	uint32_t head_size ;					// running totals of the sub blocks written so far
+	uint32_t body_size ;
+	fourcc section ;					// KEY_HEAD or KEY_BODY while their sub blocks are being written
+	struct run_stats *stats ;				// counts and times the blocks written, NULL if not wanted
+	struct config config ;					// the bin_type of the last fbin block written, alvl blocks are swapped with it
+} ;
+
+struct stream							// state for dumping a file one block at a time
+{
+	FILE *infile ;						// the binary file, read sequentially
+	FILE *outfile ;						// the text file
+	struct config config ;					// values remembered between blocks (bin_type, scalars)
+	unsigned char *buffer ;					// holds the data block currently being dumped
+	size_t buffer_size ;					// allocated size of buffer, grows to the largest block seen
+	struct dump_options *options ;				// the command line options
+	int stop ;						// set when the dump is complete before the end of the file
+} ;
+
+struct bench_params						// the synthetic file tsbench -p converts
+{
+	int channels ;						// alvl blocks per sweep set
+	int sweep_sets ;					// also written to the cnst nsweeps
+	int samples ;						// I/Q pairs per alvl block
+	fourcc bin_type ;					// written to the fbin block
+	int compact ;						// dump the text as tsdump -c does
+	int repeat ;						// each phase runs this often, the fastest run is reported
+	char *filename ;					// the synthetic file is also written here, if not NULL
+} ;
+
+struct ts_file							// the parsed file behind a libts handle, see ts.h
+{
+	struct parse_context context ;				// owns the nodes
+	unsigned char *filedata ;				// the binary file the nodes point into, NULL for a text file
+	unsigned long filesize ;
+	int mapped ;						// filedata was mapped rather than allocated
+	struct node root ;					// root.next is the first node
+	struct node **sweeps ;					// the first node of each sweep set
+	size_t nsweeps ;
 } ;
 
 
-int check_little_endian(void) ;
 void usage_tsdump(char *) ;
 void usage_tsgen(char *) ;
-int tsdump(FILE *, FILE *, int) ;
-int tsgen(FILE *, FILE *) ;
-int read_binary_file(FILE *, unsigned long, unsigned char *) ;
+int tsdump(FILE *, FILE *, struct dump_options *) ;
+int tsdump_stream(FILE *, FILE *, struct dump_options *) ;
+int tsdump_header(FILE *, FILE *, struct dump_options *) ;
+int tsdump_sweeps(FILE *, FILE *, struct dump_options *) ;
+int dump_head_blocks(int, struct parse_context *, struct config *, FILE *) ;
+int dump_range(int, off_t, size_t, struct parse_context *, struct config *, FILE *) ;
+int dump_sweep_set(int, struct index_entry *, struct range_list *, struct parse_context *, struct config *, FILE *) ;
+int tsgen(FILE *, FILE *, int, struct run_stats *) ;
+int make_block(struct parse_context *, struct node *, struct config *, struct text_reader *, char *) ;
+int read_text_list(FILE *, struct parse_context *, struct node *) ;
+int tsgen_parallel(FILE *, FILE *, int, struct run_stats *) ;
+void *gen_worker(void *) ;
+int copy_block_lines(struct text_reader *, struct text_reader *) ;
+int write_gen_item(struct gen_pool *, size_t, FILE *, struct size_patch *) ;
+int tsindex(int, char *[]) ;
+void usage_tsindex(char *) ;
+char *index_filename(char *) ;
+int load_index(char *, int, struct sweep_index *) ;
+int build_index(int, struct stat *, struct sweep_index *) ;
+int read_index(char *, struct stat *, struct sweep_index *) ;
+int write_index(char *, struct sweep_index *) ;
+struct index_entry *add_index_entry(struct sweep_index *, uint64_t) ;
+void free_index(struct sweep_index *) ;
+int tsedit(int, char *[]) ;
+void usage_tsedit(char *) ;
+int copy_range(int, uint64_t, uint64_t, FILE *, unsigned char *) ;
+int write_block_header(FILE *, fourcc, uint32_t) ;
+int parse_ranges(char *, struct range_list *) ;
+int in_ranges(struct range_list *, uint64_t) ;
+void free_ranges(struct range_list *) ;
+int tsstat(int, char *[]) ;
+void usage_tsstat(char *) ;
+int finish_sweep_stats(struct stat_state *) ;
+int tssplit(int, char *[]) ;
+void usage_tssplit(char *) ;
+int write_segment(int, struct sweep_index *, unsigned char *, size_t, uint64_t, uint64_t, char *, unsigned char *) ;
+void set_head_nsweeps(unsigned char *, size_t, int32_t) ;
+int tspack(int, char *[]) ;
+void usage_tspack(char *) ;
+int tsunpack(int, char *[]) ;
+void usage_tsunpack(char *) ;
+size_t pack_sweep_set(unsigned char *, uint32_t, unsigned char *) ;
+int unpack_sweep_set(unsigned char *, uint64_t, unsigned char *, uint32_t) ;
+uint32_t pack_alvl(unsigned char *, uint32_t, unsigned char *) ;
+int unpack_alvl(unsigned char *, uint32_t, unsigned char *, uint32_t) ;
+int zigzag_group(unsigned char *, size_t, uint16_t *, uint16_t *) ;
+void unzigzag_group(uint16_t *, size_t, uint16_t *, unsigned char *) ;
+void pack_group(uint16_t *, int, unsigned char *) ;
+void unpack_group(const unsigned char *, int, uint16_t *) ;
+uint64_t pack_checksum(const unsigned char *, size_t) ;
+void pack_header_fixup(struct pack_header *) ;
+void pack_entry_fixup(struct pack_entry *, size_t) ;
+int tsexport(int, char *[]) ;
+void usage_tsexport(char *) ;
+int write_export_array(struct ts_file *, struct export_options *) ;
+int write_npy_header(FILE *, char *, size_t *, int) ;
+int write_export_sidecar(struct ts_file *, struct export_options *, char *) ;
+void write_json_string(FILE *, const char *) ;
+int tspatch(int, char *[]) ;
+void usage_tspatch(char *) ;
+struct patch_field *find_patch_field(char *, char **) ;
+int encode_field(struct patch_field *, char *, unsigned char *) ;
+void decode_field(struct patch_field *, unsigned char *, char *) ;
+unsigned char *read_binary_file(FILE *, unsigned long *) ;
+unsigned char *map_binary_file(FILE *, unsigned long *) ;
 int check_header(unsigned char *) ;
-struct node *parse_file(unsigned char *, unsigned long) ;
-int parse_block(struct node *, unsigned char *, unsigned long) ;
+struct node *parse_file(struct parse_context *, unsigned char *, unsigned long) ;
+int parse_block(struct parse_context *, struct node *, unsigned char *, unsigned long) ;
+int parse_data(void *, uint32_t, void *, uint32_t) ;
+int walk_blocks(struct ts_events *, unsigned char *, unsigned long, struct config *, struct run_stats *) ;
 int superblock(fourcc) ;
+int stream_blocks(struct stream *, unsigned long, int) ;
 void show_list(struct node *) ;
-void free_all_nodes(struct node *) ;
-void free_all_nodes_and_data(struct node *) ;
+void *arena_alloc(struct arena *, size_t) ;
+void *arena_resize(struct arena *, void *, size_t, size_t) ;
+void arena_reset(struct arena *) ;
+void arena_release(struct arena *) ;
+void init_context(struct parse_context *) ;
+void reset_context(struct parse_context *) ;
+void release_context(struct parse_context *) ;
+struct node *new_node(struct parse_context *, struct node *, fourcc) ;
+void *new_data(struct parse_context *, struct node *, size_t) ;
 void hexdump(unsigned char *, int) ;
 void endian_fixup(void *, int) ;
 void swapcopy(unsigned char *, unsigned char *, int) ;
 void swapcopy2(unsigned char *, unsigned char *) ;
 void swapcopy4(unsigned char *, unsigned char *) ;
 void swapcopy8(unsigned char *, unsigned char *) ;
-char *strkey(fourcc) ;
+struct swap_kernel *select_swap_kernel(void) ;
+struct swap_kernel *swap_kernel(void) ;
+void choose_swap_kernel(void) ;
+int swap_supported_always(void) ;
+void swap16_scalar(void *, size_t) ;
+void swap24_scalar(void *, size_t) ;
+void swap32_scalar(void *, size_t) ;
+void power16_scalar(const void *, size_t, struct power_sum *) ;
+void unpack16_scalar(const unsigned char *, int, uint16_t *, unsigned char *, size_t) ;
+#ifdef HAVE_X86_SIMD
+int swap_supported_ssse3(void) ;
+int swap_supported_avx2(void) ;
+void swap16_ssse3(void *, size_t) ;
+void swap24_ssse3(void *, size_t) ;
+void swap32_ssse3(void *, size_t) ;
+void power16_ssse3(const void *, size_t, struct power_sum *) ;
+void unpack16_ssse3(const unsigned char *, int, uint16_t *, unsigned char *, size_t) ;
+void swap16_avx2(void *, size_t) ;
+void swap32_avx2(void *, size_t) ;
+void power16_avx2(const void *, size_t, struct power_sum *) ;
+#endif
+int tsbench(int, char *[]) ;
+void usage_tsbench(char *) ;
+int bench_kernels(size_t) ;
+int bench_pipeline(struct bench_params *, FILE *) ;
+int make_synthetic(struct bench_params *, struct parse_context *, struct node *) ;
+void *synthetic_block(struct parse_context *, struct node **, fourcc, size_t) ;
+void fixup_list(struct node *, struct config *) ;
+void report_phase(FILE *, char *, double, double, double, int) ;
+double bench_seconds(void) ;
+double cpu_seconds(void) ;
+void stats_start(struct run_stats *, struct stats_clock *) ;
+void stats_stop(struct run_stats *, int, struct stats_clock *) ;
+void count_block(struct config *, fourcc, uint32_t, fourcc) ;
+uint64_t file_bytes(FILE *) ;
+int report_stats(struct run_stats *, char *) ;
+char *strkey_r(fourcc, char *) ;
+#define SIZE_KEY 5			// four characters and a terminator
+#define strkey(key) strkey_r((key),(char [SIZE_KEY]){ 0 })	// the name of a key, in a buffer that lasts until the end of the calling block
 int fixup_sizes(struct node *) ;
 uint32_t calculate_body_size(struct node *) ;
 uint32_t calculate_head_size(struct node *) ;
 int set_block_size(struct node *, fourcc , uint32_t) ;
-int dump_list(struct node *, FILE *, int) ;
-void chomp(char *, int) ;
-int read_parameter(FILE *, char [], void *) ;
-int fixup_data(struct node *) ;
+int dump_list(struct node *, FILE *, struct dump_options *) ;
+int dump_parallel(struct node *, FILE *, struct dump_options *) ;
+void *dump_worker(void *) ;
+void track_config(struct node *, struct config *) ;
+int dump_node(struct node *, struct config *, FILE *) ;
+char *read_line(struct text_reader *) ;
+int read_block(struct text_reader *) ;
+int read_parameter(struct text_reader *, char [], void *) ;
+double parse_double(char *, char **) ;
+int format_double(double, char *) ;
+int format_count(int, char *) ;
+int dump_alvl_counts(struct node *, struct sample_codec *, FILE *) ;
+struct sample_codec *find_sample_codec(fourcc) ;
+struct sample_codec *sample_layout(fourcc) ;
+void swap_samples(struct sample_codec *, void *, size_t) ;
+int32_t get_fix3(const unsigned char *) ;
+void put_fix3(int32_t, unsigned char *) ;
+void load_fix2(const unsigned char *, size_t, double *) ;
+void load_fix3(const unsigned char *, size_t, double *) ;
+void load_fix4(const unsigned char *, size_t, double *) ;
+void load_flt4(const unsigned char *, size_t, double *) ;
+void store_fix2(const double *, size_t, unsigned char *) ;
+void store_fix3(const double *, size_t, unsigned char *) ;
+void store_fix4(const double *, size_t, unsigned char *) ;
+void store_flt4(const double *, size_t, unsigned char *) ;
+void store_counts_fix2(const int32_t *, size_t, unsigned char *) ;
+void store_counts_fix3(const int32_t *, size_t, unsigned char *) ;
+void store_counts_fix4(const int32_t *, size_t, unsigned char *) ;
+void power_wide(struct sample_codec *, unsigned char *, size_t, struct power_sum *) ;
+int fixup_data(struct node *, struct config *) ;
 struct block_functions *find_block_functions(fourcc) ;
 int ts_write(struct node *, FILE *) ;
-int count_alvl_lines(FILE *) ;
+int gen_node(struct node *, struct config *, FILE *) ;
+int write_node(struct node *, FILE *, struct size_patch *) ;
+int patch_sizes(struct size_patch *, FILE *) ;
+int patch_block_size(FILE *, long, uint32_t) ;
+struct ts_file *new_ts_file(void) ;
+unsigned char *load_binary_file(const char *, unsigned long *, int *) ;
+void unload_binary_file(unsigned char *, unsigned long, int) ;
+struct node *find_head_block(struct ts_file *, fourcc) ;
+fourcc file_bin_type(struct ts_file *) ;
+int find_sweep_sets(struct ts_file *) ;
 
 // a set of functions that dump the contents of a specific type of block
 int dump_block_aqlv(struct node *, struct config *, FILE *) ;
@@ -183,80 +687,150 @@ int dump_block_alvl(struct node *, struct config *, FILE *) ;
 int dump_block_end(struct node *, struct config *, FILE *) ;
 
 // a set of functions that fixup the data block of a specific type of block
-int fixup_data_aqlv(struct node *) ;
-int fixup_data_head(struct node *) ;
-int fixup_data_sign(struct node *) ;
-int fixup_data_mcda(struct node *) ;
-int fixup_data_cnst(struct node *) ;
-int fixup_data_swep(struct node *) ;
-int fixup_data_fbin(struct node *) ;
-int fixup_data_body(struct node *) ;
-int fixup_data_gtag(struct node *) ;
-int fixup_data_atag(struct node *) ;
-int fixup_data_indx(struct node *) ;
-int fixup_data_scal(struct node *) ;
-int fixup_data_alvl(struct node *) ;
-int fixup_data_end(struct node *) ;
+int fixup_data_aqlv(struct node *, struct config *) ;
+int fixup_data_head(struct node *, struct config *) ;
+int fixup_data_sign(struct node *, struct config *) ;
+int fixup_data_mcda(struct node *, struct config *) ;
+int fixup_data_cnst(struct node *, struct config *) ;
+int fixup_data_swep(struct node *, struct config *) ;
+int fixup_data_fbin(struct node *, struct config *) ;
+int fixup_data_body(struct node *, struct config *) ;
+int fixup_data_gtag(struct node *, struct config *) ;
+int fixup_data_atag(struct node *, struct config *) ;
+int fixup_data_indx(struct node *, struct config *) ;
+int fixup_data_scal(struct node *, struct config *) ;
+int fixup_data_alvl(struct node *, struct config *) ;
+int fixup_data_end(struct node *, struct config *) ;
 
 // a set of functions that create a node for a specific type of block
-int make_node_aqlv(struct node *, struct config *config, FILE *) ;
-int make_node_head(struct node *, struct config *config, FILE *) ;
-int make_node_sign(struct node *, struct config *config, FILE *) ;
-int make_node_mcda(struct node *, struct config *config, FILE *) ;
-int make_node_cnst(struct node *, struct config *config, FILE *) ;
-int make_node_swep(struct node *, struct config *config, FILE *) ;
-int make_node_fbin(struct node *, struct config *config, FILE *) ;
-int make_node_body(struct node *, struct config *config, FILE *) ;
-int make_node_gtag(struct node *, struct config *config, FILE *) ;
-int make_node_atag(struct node *, struct config *config, FILE *) ;
-int make_node_indx(struct node *, struct config *config, FILE *) ;
-int make_node_scal(struct node *, struct config *config, FILE *) ;
-int make_node_alvl(struct node *, struct config *config, FILE *) ;
-int make_node_end(struct node *, struct config *config, FILE *) ;
+int make_node_aqlv(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_head(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_sign(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_mcda(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_cnst(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_swep(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_fbin(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_body(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_gtag(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_atag(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_indx(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_scal(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_alvl(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
+int make_node_end(struct parse_context *, struct node *, struct config *config, struct text_reader *) ;
 
 // a set of functions that generate binary file data for a specific type of block
-int gen_block_aqlv(struct node *, FILE *) ;
-int gen_block_head(struct node *, FILE *) ;
-int gen_block_sign(struct node *, FILE *) ;
-int gen_block_mcda(struct node *, FILE *) ;
-int gen_block_cnst(struct node *, FILE *) ;
-int gen_block_swep(struct node *, FILE *) ;
-int gen_block_fbin(struct node *, FILE *) ;
-int gen_block_body(struct node *, FILE *) ;
-int gen_block_gtag(struct node *, FILE *) ;
-int gen_block_atag(struct node *, FILE *) ;
-int gen_block_indx(struct node *, FILE *) ;
-int gen_block_scal(struct node *, FILE *) ;
-int gen_block_alvl(struct node *, FILE *) ;
-int gen_block_end(struct node *, FILE *) ;
-
-
-int Global_flag_little_endian = 1 ;	// 1 indicates this code is little endian, 0 means it's big endian. The binary file is big endian.
+int gen_block_aqlv(struct node *, struct config *, FILE *) ;
+int gen_block_head(struct node *, struct config *, FILE *) ;
+int gen_block_sign(struct node *, struct config *, FILE *) ;
+int gen_block_mcda(struct node *, struct config *, FILE *) ;
+int gen_block_cnst(struct node *, struct config *, FILE *) ;
+int gen_block_swep(struct node *, struct config *, FILE *) ;
+int gen_block_fbin(struct node *, struct config *, FILE *) ;
+int gen_block_body(struct node *, struct config *, FILE *) ;
+int gen_block_gtag(struct node *, struct config *, FILE *) ;
+int gen_block_atag(struct node *, struct config *, FILE *) ;
+int gen_block_indx(struct node *, struct config *, FILE *) ;
+int gen_block_scal(struct node *, struct config *, FILE *) ;
+int gen_block_alvl(struct node *, struct config *, FILE *) ;
+int gen_block_end(struct node *, struct config *, FILE *) ;
+
+
+struct swap_kernel *Global_swap_kernel ;	// the fastest byte swap kernel this cpu supports, written once by choose_swap_kernel()
+pthread_once_t Global_swap_once = PTHREAD_ONCE_INIT ;
+struct option Global_stats_option[] =			// the one long option of tsdump and tsgen, --stats or --stats=json_file
+{
+	{ "stats", optional_argument, NULL, 'S' },
+	{ NULL, 0, NULL, 0 }
+} ;
+char *Global_stats_phase_names[STATS_PHASES] = { "read", "parse", "fixup", "format", "write" } ;
 
 
+#ifndef TS_LIBRARY		// defined when ts.c is built as libts
 int main(int argc, char *argv[])
 {
 	char *program_name = basename(argv[0]) ;
-	Global_flag_little_endian = check_little_endian() ;
 	int err = 0 ;
 	FILE *fdin ;
 	FILE *fdout ;
+	struct run_stats run_stats ;
+	memset(&run_stats,0,sizeof(struct run_stats)) ;
+	run_stats.wall_start = bench_seconds() ;
+	run_stats.cpu_start = cpu_seconds() ;
+	struct run_stats *stats = NULL ;			// set by --stats
+	if( strcmp(program_name,"tsbench") == 0 )
+		return tsbench(argc,argv) ;
+	if( strcmp(program_name,"tsindex") == 0 )
+		return tsindex(argc,argv) ;
+	if( strcmp(program_name,"tsedit") == 0 )
+		return tsedit(argc,argv) ;
+	if( strcmp(program_name,"tspatch") == 0 )
+		return tspatch(argc,argv) ;
+	if( strcmp(program_name,"tsstat") == 0 )
+		return tsstat(argc,argv) ;
+	if( strcmp(program_name,"tssplit") == 0 )
+		return tssplit(argc,argv) ;
+	if( strcmp(program_name,"tspack") == 0 )
+		return tspack(argc,argv) ;
+	if( strcmp(program_name,"tsunpack") == 0 )
+		return tsunpack(argc,argv) ;
+	if( strcmp(program_name,"tsexport") == 0 )
+		return tsexport(argc,argv) ;
 	if( strcmp(program_name,"tsdump") == 0 )
 	{
 		// do tsdump
+		struct dump_options options ;
+		memset(&options,0,sizeof(struct dump_options)) ;
+		options.threads = sysconf(_SC_NPROCESSORS_ONLN) ;
+		int option ;
+		while( (option = getopt_long(argc,argv,"a:chj:r:sx:",Global_stats_option,NULL)) != -1 )
+		{
+			switch( option )
+			{
+				case 'S':
+					stats = &run_stats ;
+					stats->jsonname = optarg ;
+				break ;
+				case 'j':
+					options.threads = atoi(optarg) ;
+				break ;
+				case 'c':
+					options.compact = 1 ;
+				break ;
+				case 'a':
+					options.select = 1 ;
+					if( parse_ranges(optarg,&options.channels) ) return 1 ;
+				break ;
+				case 'r':
+					options.select = 1 ;
+					if( parse_ranges(optarg,&options.sweeps) ) return 1 ;
+				break ;
+				case 'x':
+					options.select = 1 ;
+					if( parse_ranges(optarg,&options.indexes) ) return 1 ;
+				break ;
+				case 'h':
+					options.just_header = 1 ;
+				break ;
+				case 's':
+					options.streaming = 1 ;
+				break ;
+				default:
+					usage_tsdump(program_name) ;
+					return 1 ;
+			}
+		}
+		if( options.threads < 1 ) options.threads = 1 ;
+		if( options.threads > MAX_THREADS ) options.threads = MAX_THREADS ;
+		argv += optind-1 ;	// make argv[1] the first file name, as if there were no options
+		argc -= optind-1 ;
 		if( argc < 3 )
 		{
 			usage_tsdump(program_name) ;
 			return 0 ;
 		}
-		int just_header = 0 ;
-		if( strcmp(argv[1],"-h") == 0 )
-		{
-			just_header = 1 ;
-			argv++ ;
-			argc-- ;
-		}
 		char *infilename = argv[1] ;
+		options.infilename = infilename ;
+		options.stats = stats ;
 		if( (fdin = fopen(infilename,"rb")) == NULL )
 		{
 			printf("Cannot open input file '%s'\n",infilename) ;
@@ -269,11 +843,43 @@ int main(int argc, char *argv[])
 			fclose(fdin) ;
 			return 1 ;
 		}
-		err = tsdump(fdin,fdout,just_header) ;
+		if( options.select )
+			err = tsdump_sweeps(fdin,fdout,&options) ;
+		else if( options.just_header && !options.streaming )
+			err = tsdump_header(fdin,fdout,&options) ;
+		else if( options.streaming )
+			err = tsdump_stream(fdin,fdout,&options) ;
+		else
+			err = tsdump(fdin,fdout,&options) ;
+		free_ranges(&options.sweeps) ;
+		free_ranges(&options.indexes) ;
+		free_ranges(&options.channels) ;
 	}
 	if( strcmp(program_name,"tsgen") == 0 )
 	{
 		// do tsgen
+		int threads = sysconf(_SC_NPROCESSORS_ONLN) ;
+		int option ;
+		while( (option = getopt_long(argc,argv,"j:",Global_stats_option,NULL)) != -1 )
+		{
+			switch( option )
+			{
+				case 'S':
+					stats = &run_stats ;
+					stats->jsonname = optarg ;
+				break ;
+				case 'j':
+					threads = atoi(optarg) ;
+				break ;
+				default:
+					usage_tsgen(program_name) ;
+					return 1 ;
+			}
+		}
+		if( threads < 1 ) threads = 1 ;
+		if( threads > MAX_THREADS ) threads = MAX_THREADS ;
+		argv += optind-1 ;
+		argc -= optind-1 ;
 		if( argc < 3 )
 		{
 			usage_tsgen(program_name) ;
@@ -289,1613 +895,6165 @@ int main(int argc, char *argv[])
 		if( (fdout = fopen(outfilename,"wb")) == NULL )
 		{
 			printf("Cannot open output file '%s'\n",outfilename) ;
-			fclose(fdout) ;
+			fclose(fdin) ;
 			return 1 ;
 		}
-		err = tsgen(fdin,fdout) ;
+		err = tsgen(fdin,fdout,threads,stats) ;
+	}
+	struct stats_clock clock ;
+	stats_start(stats,&clock) ;
+	fflush(fdout) ;
+	if( stats != NULL )
+	{
+		stats->bytes_in = file_bytes(fdin) ;
+		stats->bytes_out = file_bytes(fdout) ;
 	}
 	fclose(fdin) ;
 	fclose(fdout) ;
+	stats_stop(stats,STATS_WRITE,&clock) ;
+	if( stats != NULL && report_stats(stats,program_name) )
+		err = 1 ;
 	return err ;
 }
-
-int check_little_endian(void)	// check whether this code is big or little endian, returns 1 for little.
-{
-	unsigned int i = 1 ;
-	char *c = (char *)&i ;
-	if( *c )		
-		return 1 ;	// little endian
-	return 0 ;
-}
+#endif
 
 void usage_tsdump(char *name)
 {
-	printf("Usage: %s [-h] infile outfile\n",name) ;
+	printf("Usage: %s [-a channels] [-c] [-h] [-j threads] [-r positions] [-s] [-x indexes] [--stats[=json_file]] infile outfile\n",name) ;
 	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
 	printf("Reads a binary infile and writes an ascii text version to outfile.\n") ;
+	printf("  -a  dump only these alvl channels of each sweep set, counted from 1, e.g. 1,3\n") ;
+	printf("  -c  write alvl samples as compact integer counts\n") ;
+	printf("  -h  dump only the header blocks\n") ;
+	printf("  -j  format sweep sets on this many threads, default one per cpu\n") ;
+	printf("  -r  dump only the sweep sets at these positions, counted from 1, e.g. 1-10,50\n") ;
+	printf("  -s  stream the file one block at a time, in bounded memory\n") ;
+	printf("  -x  dump only the sweep sets with these indx values\n") ;
+	printf("  -a, -r and -x find the sweep sets through the index sidecar and read only those selected\n") ;
+	printf("  --stats  report block counts, time per phase, bytes and peak memory on stderr, or as JSON in json_file\n") ;
 }
 
 void usage_tsgen(char *name)
 {
-	printf("Usage: %s infile outfile\n",name) ;
+	printf("Usage: %s [-j threads] [--stats[=json_file]] infile outfile\n",name) ;
 	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
 	printf("Reads an ascii text infile and writes a binary version to outfile.\n") ;
+	printf("  -j  parse alvl blocks on this many threads, default one per cpu\n") ;
+	printf("  --stats  report block counts, time per phase, bytes and peak memory on stderr, or as JSON in json_file\n") ;
 }
 
-int tsdump(FILE *infile, FILE *outfile, int just_header)
+int tsdump(FILE *infile, FILE *outfile, struct dump_options *options)
 {
-	fseek(infile,0L,SEEK_END) ;	// seek to the end of the file
-	unsigned long filesize = ftell(infile) ;
-	rewind(infile) ;
-	unsigned char *filedata = malloc(filesize) ;	// try to make a buffer sized to read the entire file
-	if( filedata == NULL )
-	{
-		printf("Cannot get memory for file with %ld bytes\n",filesize) ;
-		return 1 ;
-	}
-	int err = 0 ;
-	if( read_binary_file(infile,filesize,filedata) == 0 )
+	struct stats_clock clock ;
+	stats_start(options->stats,&clock) ;
+	unsigned long filesize = 0 ;
+	unsigned char *filedata = map_binary_file(infile,&filesize) ;	// try to map the file, the parser then walks the page cache directly
+	int mapped = ( filedata != NULL ) ;
+	if( mapped )
 	{
-		struct node *list = parse_file(filedata,filesize) ;
-		if( list != NULL )
+		if( filesize > sizeof(struct block_header) && check_header(filedata) )
 		{
-			err = dump_list(list,outfile,just_header) ;
-			free_all_nodes(list) ;
+			munmap(filedata,filesize) ;
+			return 1 ;
 		}
 	}
-	free(filedata) ;
+	else if( (filedata = read_binary_file(infile,&filesize)) == NULL )	// cannot map (e.g. a pipe), fall back to reading the whole file
+		return 1 ;
+	stats_stop(options->stats,STATS_READ,&clock) ;
+	int err = 0 ;
+	struct parse_context context ;
+	init_context(&context) ;
+	context.stats = options->stats ;
+	stats_start(options->stats,&clock) ;
+	struct node *list = parse_file(&context,filedata,filesize) ;
+	stats_stop(options->stats,STATS_PARSE,&clock) ;
+	stats_start(options->stats,&clock) ;
+	if( list != NULL && options->threads > 1 )
+		err = dump_parallel(list,outfile,options) ;
+	else if( list != NULL )
+		err = dump_list(list,outfile,options) ;
+	stats_stop(options->stats,STATS_FORMAT,&clock) ;
+	release_context(&context) ;
+	if( mapped )
+		munmap(filedata,filesize) ;
+	else
+		free(filedata) ;
 	return err ;
 }
 
-#define SIZE_LINE 80
+unsigned char *map_binary_file(FILE *tsfile, unsigned long *filesize)	// maps the whole file copy-on-write, returns NULL if it cannot be mapped
+{
+	struct stat st ;
+	int fd = fileno(tsfile) ;
+	if( fstat(fd,&st) != 0 ) return NULL ;
+	if( !S_ISREG(st.st_mode) || st.st_size == 0 ) return NULL ;
+	// MAP_PRIVATE because the parser does endian fixup in place, writes must never reach the file
+	void *map = mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0) ;
+	if( map == MAP_FAILED ) return NULL ;
+	madvise(map,st.st_size,MADV_SEQUENTIAL) ;	// the parser walks the file front to back
+	*filesize = st.st_size ;
+	return map ;
+}
 
-int tsgen(FILE *infile, FILE *outfile)
+int tsdump_stream(FILE *infile, FILE *outfile, struct dump_options *options)	// dumps each block as soon as it is read, memory use is bounded by the largest block
 {
-	char line[SIZE_LINE] ;
-	long line_count = 0 ;
-	struct config config ;
-	memset(&config,0,sizeof(struct config)) ;
-	struct node root ;
-	struct node *list = &root ;
-	memset(list,0,sizeof(struct node)) ;
-	while( fgets(line,SIZE_LINE,infile) )
+	struct stream stream ;
+	memset(&stream,0,sizeof(struct stream)) ;
+	stream.infile = infile ;
+	stream.outfile = outfile ;
+	stream.options = options ;
+	stream.config.compact = options->compact ;
+	int err = stream_blocks(&stream,0,1) ;
+	free(stream.buffer) ;
+	return err ;
+}
+
+int stream_blocks(struct stream *stream, unsigned long length, int top)	// reads and dumps the blocks in length bytes, or up to the end of the file at top level
+{
+	int first = top ;
+	while( top || length > 0 )
 	{
-		chomp(line,SIZE_LINE) ;				// remove newline
-		//printf("debug: chomped line is '%s'\n",line) ;
-		line_count++ ;
-		if( strlen(line) <= 1 ) continue ;		// skip empty lines
-		if( index(line,':') != NULL ) continue ;	// skip parameter lines
-		fourcc key = *(fourcc *)line ;			// extract the block type
-		endian_fixup(&key,sizeof(key)) ;
-		struct block_functions *block_functions = find_block_functions(key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
-		if( block_functions == NULL )
+		struct run_stats *stats = stream->options->stats ;
+		struct stats_clock clock ;
+		stats_start(stats,&clock) ;
+		struct block_header header ;
+		size_t count = fread(&header,1,sizeof(struct block_header),stream->infile) ;
+		stats_stop(stats,STATS_READ,&clock) ;
+		if( count == 0 && top && feof(stream->infile) )
+			return 0 ;					// clean end of file
+		if( count != sizeof(struct block_header) )
 		{
-			printf("Cannot gen block '%s'\n",strkey(key)) ;
+			printf("Error reading ts file, truncated block header\n") ;
 			return 1 ;
 		}
-		int (*make_function)(struct node *, struct config *, FILE *) = block_functions->make ;
-		int err = (*make_function)(list,&config,infile) ;	// calls the 'make' function from Function_dictionary corresponding to the block type
-		if( err )
-		{
-			printf("Error in '%s' block starting at line %ld\n",strkey(key),line_count) ;
+		if( first && check_header((unsigned char *)&header) )	// the file must start with an AQVL block
 			return 1 ;
+		first = 0 ;
+		struct node node ;
+		memset(&node,0,sizeof(struct node)) ;
+		node.key = header.key ;
+		endian_fixup(&(node.key),sizeof(node.key)) ;
+		node.size = header.size ;
+		endian_fixup(&(node.size),sizeof(node.size)) ;
+		if( !top )
+		{
+			length -= sizeof(struct block_header) ;
+			if( node.size > length )
+			{
+				printf("Block '%s' size truncted from %u to %lu bytes\n",strkey(node.key),node.size,length) ;
+				node.size = length ;
+			}
+			length -= node.size ;
 		}
-		if( list->next != NULL ) list = list->next ;	// advance the list pointer to the newly created node
-	}
-	printf("Read %ld lines\n",line_count) ;
-	fixup_sizes(&root) ;	// calculate body, head and aqlv block sizes, update nodes
-	// write to outfile
-	int err = ts_write(root.next,outfile) ;
-	free_all_nodes_and_data(list) ;
-	return err ;
-}
-
-int ts_write(struct node *list, FILE *outfile)
-{
-	//printf("debug: ts_write: start\n") ;
-	while( list != NULL )
-	{
-		fourcc key = list->key ;
-		struct block_functions *block_functions = find_block_functions(key) ;	// gets a set of functions from Global_functions_dictionary for this block type
-		if( block_functions == NULL )
+		if( stats != NULL && !(node.key == KEY_BODY && stream->options->just_header) )
+			count_block(&(stats->counts),node.key,node.size,stream->config.bin_type) ;
+		if( superblock(node.key) )
+		{
+			if( node.key == KEY_BODY && stream->options->just_header )
+			{
+				stream->stop = 1 ;
+				return 0 ;
+			}
+			stats_start(stats,&clock) ;
+			if( dump_node(&node,&(stream->config),stream->outfile) )
+				return 1 ;
+			stats_stop(stats,STATS_FORMAT,&clock) ;
+			if( stream_blocks(stream,node.size,0) )		// dump the sub blocks before moving on
+				return 1 ;
+			if( stream->stop )
+				return 0 ;
+			continue ;
+		}
+		if( node.size > stream->buffer_size )			// grow the buffer, it is reused for every block
+		{
+			unsigned char *buffer = realloc(stream->buffer,node.size) ;
+			if( buffer == NULL )
+			{
+				printf("Cannot get memory for block '%s' with %u bytes\n",strkey(node.key),node.size) ;
+				return 1 ;
+			}
+			stream->buffer = buffer ;
+			stream->buffer_size = node.size ;
+		}
+		stats_start(stats,&clock) ;
+		if( fread(stream->buffer,1,node.size,stream->infile) != node.size )
 		{
-			printf("Cannot write block '%s'\n",strkey(list->key)) ;
+			printf("Error reading ts file, truncated '%s' block\n",strkey(node.key)) ;
 			return 1 ;
 		}
-		int (*gen_function)(struct node *, FILE *) = block_functions->gen ;
-		int err = (*gen_function)(list,outfile) ;	// calls the 'gen' function corresponding to the block type
-		if( err )
+		stats_stop(stats,STATS_READ,&clock) ;
+		node.data = stream->buffer ;
+		stats_start(stats,&clock) ;
+		if( fixup_data(&node,&(stream->config)) )
 		{
-			printf("Error in '%s' block\n",strkey(key)) ;
+			if( stats != NULL ) stats->counts.count_bad++ ;
 			return 1 ;
 		}
-		list = list->next ;
+		stats_stop(stats,STATS_FIXUP,&clock) ;
+		stats_start(stats,&clock) ;
+		if( dump_node(&node,&(stream->config),stream->outfile) )
+			return 1 ;
+		stats_stop(stats,STATS_FORMAT,&clock) ;
 	}
-	//printf("debug: ts_write: finish\n") ;
 	return 0 ;
 }
 
-void chomp(char *line, int max)		// delete trailing newline character
+int tsdump_header(FILE *infile, FILE *outfile, struct dump_options *options)	// reads just the blocks in front of BODY with pread(), BODY is skipped unread
 {
-	line[max-1] = '\0' ;
-	char *nl = index(line,0x0a) ;
-	if( nl ) *nl = '\0' ;
+	int fd = fileno(infile) ;
+	struct block_header header ;
+	if( pread(fd,&header,sizeof(struct block_header),0) != sizeof(struct block_header) )
+		return tsdump_stream(infile,outfile,options) ;		// cannot pread (e.g. a pipe), streaming also stops at BODY
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	config.compact = options->compact ;
+	struct parse_context context ;
+	init_context(&context) ;
+	context.stats = options->stats ;
+	int err = ( dump_head_blocks(fd,&context,&config,outfile) < 0 ) ;
+	release_context(&context) ;
+	return err ;
 }
 
-int read_parameter(FILE *fd, char format[], void *buffer)	// looks for a line with format, copies the value to buffer
+int tsdump_sweeps(FILE *infile, FILE *outfile, struct dump_options *options)	// dumps the header and the selected sweep sets, found through the index sidecar, the others are never read
 {
-	size_t block_start = ftell(fd) ;	// put a finger in the file at the first line of the block
-	int err = 0 ;
-	char line[SIZE_LINE] ;
-	//printf("debug: read_parameters: format='%s'\n",format) ;
-	while( fgets(line,SIZE_LINE,fd) )
+	int fd = fileno(infile) ;
+	struct sweep_index index ;
+	if( load_index(options->infilename,fd,&index) )
+		return 1 ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	config.compact = options->compact ;
+	struct parse_context context ;
+	init_context(&context) ;
+	context.stats = options->stats ;
+	int err = ( dump_head_blocks(fd,&context,&config,outfile) < 0 ) ;
+	struct node node ;
+	memset(&node,0,sizeof(struct node)) ;
+	node.key = KEY_BODY ;
+	if( options->stats != NULL )
+		count_block(&(options->stats->counts),KEY_BODY,0,0) ;
+	if( err == 0 )
+		err = dump_node(&node,&config,outfile) ;
+	uint64_t selected = 0 ;
+	for( uint64_t loop = 0 ; err == 0 && loop < index.header.count ; loop++ )
 	{
-		chomp(line,SIZE_LINE) ;
-		if( strlen(line) == 0 )
-		{
-			printf("Cannot find parameter '%s'\n",format) ;
-			err = 1 ;
-			break ;			// stop on blank line
-		}
-		//printf("debug: read_parameters: line='%s'\n",line) ;
-		int count = sscanf(line,format,buffer) ;
-		//printf("debug: read_parameters: sscanf returned %d\n",count) ;
-		if( count != 0 )
-		{
-			//printf("debug: read_parameters: using line %s\n",line) ;
-			err = 0 ;
-			break ;
-		}
+		struct index_entry *entry = &(index.entries[loop]) ;
+		if( options->sweeps.count > 0 && !in_ranges(&(options->sweeps),loop+1) ) continue ;
+		if( options->indexes.count > 0 && !in_ranges(&(options->indexes),entry->index) ) continue ;
+		err = dump_sweep_set(fd,entry,&(options->channels),&context,&config,outfile) ;
+		selected++ ;
+	}
+	if( err == 0 && selected == 0 )
+		printf("No sweep sets selected, the file has %llu\n",(unsigned long long )index.header.count) ;
+	struct block_header header ;				// finish with END, if the file has one after BODY
+	if( err == 0 && pread(fd,&header,sizeof(struct block_header),index.header.end_offset) == sizeof(struct block_header) )
+	{
+		node.key = header.key ;
+		endian_fixup(&(node.key),sizeof(node.key)) ;
+		if( node.key == KEY_END && options->stats != NULL )
+			count_block(&(options->stats->counts),KEY_END,0,0) ;
+		if( node.key == KEY_END )
+			err = dump_node(&node,&config,outfile) ;
 	}
-	fseek(fd,block_start,SEEK_SET) ;
+	release_context(&context) ;
+	free_index(&index) ;
 	return err ;
 }
 
-int read_binary_file(FILE * tsfile, unsigned long filesize, unsigned char *buffer)
+int dump_head_blocks(int fd, struct parse_context *context, struct config *config, FILE *outfile)	// dumps AQVL and the blocks in it up to BODY, returns the offset of BODY or -1
 {
-	unsigned long count = fread(buffer,1,filesize,tsfile) ;
-	if( count != filesize )
+	struct block_header header ;
+	if( pread(fd,&header,sizeof(struct block_header),0) != sizeof(struct block_header) )
 	{
-		printf("Error reading ts file, only read %lu bytes out of %lu\n",count,filesize) ;
-		return 1 ;
+		printf("Cannot read ts file header\n") ;
+		return -1 ;
 	}
-	if( count > sizeof(struct block_header) )
+	if( check_header((unsigned char *)&header) )
+		return -1 ;
+	if( context->stats != NULL )
+		count_block(&(context->stats->counts),KEY_AQLV,0,0) ;
+	struct node aqlv ;
+	memset(&aqlv,0,sizeof(struct node)) ;
+	aqlv.key = KEY_AQLV ;
+	if( dump_node(&aqlv,config,outfile) )
+		return -1 ;
+	off_t offset = sizeof(struct block_header) ;		// step inside AQVL
+	while( pread(fd,&header,sizeof(struct block_header),offset) == sizeof(struct block_header) )
 	{
-		if( check_header(buffer) )
-			return 1 ;
+		fourcc key = header.key ;
+		endian_fixup(&key,sizeof(key)) ;
+		uint32_t size = header.size ;
+		endian_fixup(&size,sizeof(size)) ;
+		if( key == KEY_BODY || key == KEY_END )
+			break ;
+		size_t length = sizeof(struct block_header) + size ;	// the whole block, header included
+		if( dump_range(fd,offset,length,context,config,outfile) )
+			return -1 ;
+		offset += length ;
 	}
-	return 0 ;
+	return offset ;
 }
 
-int check_header(unsigned char *buffer)
+int dump_sweep_set(int fd, struct index_entry *entry, struct range_list *channels, struct parse_context *context, struct config *config, FILE *outfile)	// dumps one sweep set, leaving out the alvl blocks of unselected channels unparsed
 {
-	struct block_header *header = (struct block_header *)buffer ;
-	fourcc key = header->key ;
-	endian_fixup(&key,sizeof(key)) ;
-	//printf("debug: check_header: read %x as %x\n",header->key,key) ;
-	if( key != KEY_AQLV )
+	if( channels->count == 0 )
+		return dump_range(fd,entry->offset,entry->length,context,config,outfile) ;
+	unsigned char *buffer = malloc(entry->length) ;
+	if( buffer == NULL )
 	{
-		printf("Bad header key: %x\n",key) ;
+		printf("Cannot get memory for %u bytes of blocks\n",entry->length) ;
 		return 1 ;
 	}
-	// TODO check file size (meh?)
-	return 0 ;
+	struct stats_clock clock ;
+	stats_start(context->stats,&clock) ;
+	int err = ( pread(fd,buffer,entry->length,entry->offset) != (ssize_t )entry->length ) ;
+	stats_stop(context->stats,STATS_READ,&clock) ;
+	if( err )
+		printf("Error reading ts file at offset %llu\n",(unsigned long long )entry->offset) ;
+	uint64_t channel = 0 ;
+	for( size_t offset = 0 ; !err && offset + sizeof(struct block_header) <= entry->length ; )
+	{
+		struct block_header header ;
+		memcpy(&header,buffer+offset,sizeof(struct block_header)) ;
+		endian_fixup(&(header.key),sizeof(header.key)) ;
+		endian_fixup(&(header.size),sizeof(header.size)) ;
+		size_t length = sizeof(struct block_header) + header.size ;
+		if( length > entry->length - offset )
+			length = entry->length - offset ;
+		if( header.key != KEY_alvl || in_ranges(channels,++channel) )	// skipped by size, never fixed up
+		{
+			struct node root ;
+			memset(&root,0,sizeof(struct node)) ;
+			stats_start(context->stats,&clock) ;
+			err = parse_block(context,&root,buffer+offset,length) ;
+			stats_stop(context->stats,STATS_PARSE,&clock) ;
+			stats_start(context->stats,&clock) ;
+			for( struct node *node = root.next ; node != NULL && err == 0 ; node = node->next )
+				err = dump_node(node,config,outfile) ;
+			stats_stop(context->stats,STATS_FORMAT,&clock) ;
+		}
+		offset += length ;
+	}
+	reset_context(context) ;
+	free(buffer) ;
+	return err ;
 }
 
-struct node *parse_file(unsigned char *buffer, unsigned long length)
+int dump_range(int fd, off_t offset, size_t length, struct parse_context *context, struct config *config, FILE *outfile)	// reads whole blocks from offset with pread(), parses and dumps them
 {
-	struct node dummy_root ;	// use a dummy root node to prime the parser
-	if( parse_block(&dummy_root,buffer,length) )
+	unsigned char *buffer = malloc(length) ;
+	if( buffer == NULL )
 	{
-		printf("Parser error\n") ;
-		return NULL ;
+		printf("Cannot get memory for %zu bytes of blocks\n",length) ;
+		return 1 ;
 	}
-	return dummy_root.next ;	// return the next node as the true root
+	struct stats_clock clock ;
+	stats_start(context->stats,&clock) ;
+	ssize_t count = pread(fd,buffer,length,offset) ;
+	stats_stop(context->stats,STATS_READ,&clock) ;
+	if( count < (ssize_t )sizeof(struct block_header) )
+	{
+		printf("Error reading ts file at offset %lld\n",(long long )offset) ;
+		free(buffer) ;
+		return 1 ;
+	}
+	struct node root ;
+	memset(&root,0,sizeof(struct node)) ;
+	stats_start(context->stats,&clock) ;
+	int err = parse_block(context,&root,buffer,count) ;
+	stats_stop(context->stats,STATS_PARSE,&clock) ;
+	stats_start(context->stats,&clock) ;
+	for( struct node *node = root.next ; node != NULL && err == 0 ; node = node->next )
+		err = dump_node(node,config,outfile) ;
+	stats_stop(context->stats,STATS_FORMAT,&clock) ;
+	reset_context(context) ;
+	free(buffer) ;
+	return err ;
 }
 
-int parse_block(struct node *root, unsigned char *buffer, unsigned long length)
+#define SIZE_READ_BUFFER (1024*1024)
+
+int tsgen(FILE *infile, FILE *outfile, int threads, struct run_stats *stats)
 {
-	while( length > 0 )
+	long start = ftell(outfile) ;
+	int streaming = ( start >= 0 && fseek(outfile,start,SEEK_SET) == 0 ) ;	// sizes can be patched later in a seekable file, otherwise keep the whole list
+	if( streaming && threads > 1 )
+		return tsgen_parallel(infile,outfile,threads,stats) ;
+	struct text_reader reader ;
+	memset(&reader,0,sizeof(struct text_reader)) ;
+	reader.fd = infile ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	struct parse_context context ;
+	init_context(&context) ;
+	struct node root ;
+	struct node *list = &root ;
+	memset(list,0,sizeof(struct node)) ;
+	struct size_patch patch ;
+	memset(&patch,0,sizeof(struct size_patch)) ;
+	patch.offset_aqlv = patch.offset_head = patch.offset_body = -1 ;
+	patch.stats = stats ;
+	int err = 0 ;
+	char *line ;
+	struct stats_clock clock ;
+	stats_start(stats,&clock) ;
+	while( (line = read_line(&reader)) != NULL )
 	{
-		// make a new node to describe this block
-		struct node *newnode = malloc(sizeof(struct node)) ;
-		if( newnode == NULL )
-		{
-			printf("Malloc error\n") ;
-			return 1 ;
-		}
-		memset(newnode,0,sizeof(struct node)) ;
-		root->next = newnode ;					// link the previous node to the new node
-		struct block_header *header = (struct block_header *)buffer ;	// make buffer contents accessible through struct block_header
-		endian_fixup(&(header->key),sizeof(newnode->key)) ;	// fixup the endian order
-		newnode->key = header->key ;				// copy the block type, aka key, from the header
-		endian_fixup(&(header->size),sizeof(newnode->size)) ;	// fixup the endian order
-		newnode->size = header->size ;				// copy the size of the data block (excluding header)
-		length -= sizeof(struct block_header) ;			// reduce the block length by the size of the header
-		buffer += sizeof(struct block_header) ;			// advance the buffer pointer by the size of the header
-		if( newnode->size > length )
+		//printf("debug: line is '%s'\n",line) ;
+		err = make_block(&context,list,&config,&reader,line) ;
+		if( err ) break ;
+		if( list->next == NULL ) continue ;
+		if( streaming )					// write the new node straight away and forget it
 		{
-			printf("Block '%s' size truncted from %u to %lu bytes\n",strkey(newnode->key),newnode->size,length) ;
-			newnode->size = length ;
+			stats_stop(stats,STATS_PARSE,&clock) ;	// write_node() times itself
+			struct node *node = list->next ;
+			list->next = NULL ;
+			err = write_node(node,outfile,&patch) ;
+			reset_context(&context) ;		// the node and its data are done with, reuse the memory
+			if( err ) break ;
+			stats_start(stats,&clock) ;
 		}
-		newnode->data = buffer ;				// point at the data portion of the block
-		if( superblock(newnode->key) )				// if the block is a superblock, recursively parse its data block
+		else
+			list = list->next ;			// advance the list pointer to the newly created node
+	}
+	if( err == 0 )
+		stats_stop(stats,STATS_PARSE,&clock) ;
+	free(reader.buffer) ;
+	free(reader.block) ;
+	if( err == 0 )
+	{
+		printf("Read %ld lines\n",reader.line_count) ;
+		if( streaming )
 		{
-			if( parse_block(newnode,newnode->data,newnode->size) )
-				return 1 ;
+			stats_start(stats,&clock) ;
+			err = patch_sizes(&patch,outfile) ;		// go back and fill in the body, head and aqlv block sizes
+			stats_stop(stats,STATS_WRITE,&clock) ;
 		}
 		else
 		{
-			if( fixup_data(newnode) )			// otherwise, do endian fixup on the block's data, other stuff too (?)
-				return 1 ;
+			fixup_sizes(&root) ;	// calculate body, head and aqlv block sizes, update nodes
+			// write to outfile
+			for( struct node *node = root.next ; node != NULL && err == 0 ; node = node->next )
+				err = write_node(node,outfile,&patch) ;
 		}
-		// move on to the next block in the buffer
-		length -= newnode->size ;				// reduce the block length by the size of the data block
-		buffer += newnode->size ;				// advance the buffer pointer by the size of the data block
-		do{							// iterate to deal with recursive parsing
-			root = root->next ;				// advance the root pointer to the new node, ready to iterate
-		}while( root->next != NULL ) ;
+	}
+	release_context(&context) ;
+	return err ;
+}
+
+int make_block(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader, char *line)	// makes a node after list if line names a block, consuming the block's lines
+{
+	long line_count = reader->line_count ;
+	if( strlen(line) <= 1 ) return 0 ;		// skip empty lines
+	if( index(line,':') != NULL ) return 0 ;	// skip parameter lines
+	fourcc key ;
+	memcpy(&key,line,sizeof(key)) ;			// extract the block type, the line need not be aligned
+	endian_fixup(&key,sizeof(key)) ;
+	struct block_functions *block_functions = find_block_functions(key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
+	if( block_functions == NULL )
+	{
+		printf("Cannot gen block '%s'\n",strkey(key)) ;
+		return 1 ;
+	}
+	int (*make_function)(struct parse_context *, struct node *, struct config *, struct text_reader *) = block_functions->make ;
+	if( (*make_function)(context,list,config,reader) )	// calls the 'make' function from Function_dictionary corresponding to the block type, it consumes the block's lines
+	{
+		printf("Error in '%s' block starting at line %ld\n",strkey(key),line_count) ;
+		return 1 ;
 	}
 	return 0 ;
 }
 
-struct block_functions Global_function_dictionary[] =		// a dictionary of  names and associated functions, used to lookup which function to call
+#define GEN_WINDOW	16		// blocks read ahead of the writer, per thread
+
+int tsgen_parallel(FILE *infile, FILE *outfile, int threads, struct run_stats *stats)	// reads the text on this thread, parses alvl blocks on workers, writes the blocks in order
 {
-	{ KEY_alvl, fixup_data_alvl, make_node_alvl, dump_block_alvl, gen_block_alvl  },
-	{ KEY_gtag, fixup_data_gtag, make_node_gtag, dump_block_gtag, gen_block_gtag  },
-	{ KEY_atag, fixup_data_atag, make_node_atag, dump_block_atag, gen_block_atag  },
-	{ KEY_indx, fixup_data_indx, make_node_indx, dump_block_indx, gen_block_indx  },
-	{ KEY_scal, fixup_data_scal, make_node_scal, dump_block_scal, gen_block_scal  },
-	{ KEY_sign, fixup_data_sign, make_node_sign, dump_block_sign, gen_block_sign  },
-	{ KEY_mcda, fixup_data_mcda, make_node_mcda, dump_block_mcda, gen_block_mcda  },
-	{ KEY_cnst, fixup_data_cnst, make_node_cnst, dump_block_cnst, gen_block_cnst  },
-	{ KEY_swep, fixup_data_swep, make_node_swep, dump_block_swep, gen_block_swep  },
-	{ KEY_fbin, fixup_data_fbin, make_node_fbin, dump_block_fbin, gen_block_fbin  },
-	{ KEY_AQLV, fixup_data_aqlv, make_node_aqlv, dump_block_aqlv, gen_block_aqlv  },
-	{ KEY_HEAD, fixup_data_head, make_node_head, dump_block_head, gen_block_head  },
-	{ KEY_BODY, fixup_data_body, make_node_body, dump_block_body, gen_block_body  },
-	{ KEY_END, fixup_data_end, make_node_end, dump_block_end, gen_block_end  },
-	{ 0, NULL, NULL, NULL, NULL }
-} ;
-
-struct block_functions *find_block_functions(fourcc key)
-{
-	if( key == 0 )
+	struct text_reader reader ;
+	memset(&reader,0,sizeof(struct text_reader)) ;
+	reader.fd = infile ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	struct size_patch patch ;
+	memset(&patch,0,sizeof(struct size_patch)) ;
+	patch.offset_aqlv = patch.offset_head = patch.offset_body = -1 ;
+	patch.stats = stats ;
+	struct gen_pool pool ;
+	memset(&pool,0,sizeof(struct gen_pool)) ;
+	pool.window = GEN_WINDOW*threads ;
+	if( (pool.items = calloc(pool.window,sizeof(struct gen_item))) == NULL )
 	{
-		printf("Bad key (zero!)\n") ;
-		return NULL ;
+		printf("Cannot get memory for %zu tsgen items\n",pool.window) ;
+		return 1 ;
 	}
-	for( struct block_functions *block_functions = Global_function_dictionary ; block_functions->key != 0 ; block_functions++ )
+	for( size_t loop = 0 ; loop < pool.window ; loop++ )
+		init_context(&(pool.items[loop].context)) ;
+	pthread_mutex_init(&pool.lock,NULL) ;
+	pthread_cond_init(&pool.ready,NULL) ;
+	pthread_cond_init(&pool.work,NULL) ;
+	pthread_t workers[MAX_THREADS] ;
+	int nworkers = 0 ;
+	while( nworkers < threads && pthread_create(&workers[nworkers],NULL,gen_worker,&pool) == 0 )
+		nworkers++ ;
+	int err = ( nworkers == 0 ) ;
+	if( err )
+		printf("Cannot start tsgen threads\n") ;
+	char *line ;
+	struct stats_clock clock ;
+	stats_start(stats,&clock) ;
+	while( !err && (line = read_line(&reader)) != NULL )
 	{
-		if( key == block_functions->key )
-			return block_functions ;
+		long line_count = reader.line_count ;
+		if( strlen(line) <= 1 ) continue ;		// skip empty lines
+		if( index(line,':') != NULL ) continue ;	// skip parameter lines
+		fourcc key ;
+		memcpy(&key,line,sizeof(key)) ;
+		endian_fixup(&key,sizeof(key)) ;
+		struct block_functions *block_functions = find_block_functions(key) ;
+		if( block_functions == NULL )
+		{
+			printf("Cannot gen block '%s'\n",strkey(key)) ;
+			err = 1 ;
+			break ;
+		}
+		if( pool.submitted - pool.written == pool.window )	// the ring is full, wait for the oldest block and write it
+		{
+			stats_stop(stats,STATS_PARSE,&clock) ;	// write_node() times itself
+			if( (err = write_gen_item(&pool,pool.written,outfile,&patch)) )
+				break ;
+			stats_start(stats,&clock) ;
+		}
+		struct gen_item *item = &(pool.items[pool.submitted % pool.window]) ;
+		item->sequence = pool.submitted ;
+		item->line_count = line_count ;
+		item->done = 0 ;
+		memset(&(item->root),0,sizeof(struct node)) ;
+		if( key == KEY_alvl )			// leave the parsing to a worker, with the scaling in force now
+		{
+			item->job = 1 ;
+			item->config = config ;
+			err = copy_block_lines(&reader,&(item->reader)) ;
+		}
+		else
+		{
+			item->job = 0 ;
+			item->err = (*block_functions->make)(&(item->context),&(item->root),&config,&reader) ;
+			item->done = 1 ;
+			if( item->err )
+			{
+				printf("Error in '%s' block starting at line %ld\n",strkey(key),line_count) ;
+				err = 1 ;
+			}
+		}
+		if( err ) break ;
+		pthread_mutex_lock(&pool.lock) ;
+		pool.submitted++ ;
+		pthread_cond_signal(&pool.work) ;
+		int head_done = pool.items[pool.written % pool.window].done ;
+		pthread_mutex_unlock(&pool.lock) ;
+		if( head_done )				// write the oldest block if it is ready, without waiting
+		{
+			stats_stop(stats,STATS_PARSE,&clock) ;
+			err = write_gen_item(&pool,pool.written,outfile,&patch) ;
+			stats_start(stats,&clock) ;
+		}
 	}
-	printf("Cannot locate functions for key '%s'\n",strkey(key)) ;
-	return NULL ;
+	stats_stop(stats,STATS_PARSE,&clock) ;
+	while( !err && pool.written < pool.submitted )
+		err = write_gen_item(&pool,pool.written,outfile,&patch) ;
+	pthread_mutex_lock(&pool.lock) ;
+	pool.stop = 1 ;
+	pthread_cond_broadcast(&pool.work) ;
+	pthread_mutex_unlock(&pool.lock) ;
+	for( int loop = 0 ; loop < nworkers ; loop++ )
+		pthread_join(workers[loop],NULL) ;
+	for( size_t loop = 0 ; loop < pool.window ; loop++ )
+	{
+		release_context(&(pool.items[loop].context)) ;
+		free(pool.items[loop].reader.buffer) ;
+	}
+	free(pool.items) ;
+	free(reader.buffer) ;
+	free(reader.block) ;
+	pthread_cond_destroy(&pool.work) ;
+	pthread_cond_destroy(&pool.ready) ;
+	pthread_mutex_destroy(&pool.lock) ;
+	if( err == 0 )
+	{
+		printf("Read %ld lines\n",reader.line_count) ;
+		stats_start(stats,&clock) ;
+		err = patch_sizes(&patch,outfile) ;
+		stats_stop(stats,STATS_WRITE,&clock) ;
+	}
+	return err ;
 }
 
-int fixup_data(struct node *node)	// figures out what type of block and what to do with it
+void *gen_worker(void *argument)	// parses the alvl blocks in the pool as they arrive, until stop is set
 {
-	struct block_functions *block_functions = find_block_functions(node->key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
-	if( block_functions == NULL )
+	struct gen_pool *pool = argument ;
+	pthread_mutex_lock(&pool->lock) ;
+	for( ;; )
 	{
-		printf("Cannot fixup block '%s'\n",strkey(node->key)) ;
-		return 1 ;
+		if( pool->next_job < pool->written )		// these were written, so they needed no worker
+			pool->next_job = pool->written ;
+		while( pool->next_job < pool->submitted && !pool->items[pool->next_job % pool->window].job )
+			pool->next_job++ ;
+		if( pool->next_job < pool->submitted )
+		{
+			struct gen_item *item = &(pool->items[pool->next_job++ % pool->window]) ;
+			pthread_mutex_unlock(&pool->lock) ;
+			int err = make_node_alvl(&(item->context),&(item->root),&(item->config),&(item->reader)) ;
+			pthread_mutex_lock(&pool->lock) ;
+			item->err = err ;
+			item->done = 1 ;
+			pthread_cond_broadcast(&pool->ready) ;
+			continue ;
+		}
+		if( pool->stop )
+			break ;
+		pthread_cond_wait(&pool->work,&pool->lock) ;
 	}
-	int (*fixup_function)(struct node *) = block_functions->fixup ;
-	int err = (*fixup_function)(node) ;	// calls the fixup function corresponding to the block key
-	if( err )
+	pthread_mutex_unlock(&pool->lock) ;
+	return NULL ;
+}
+
+int copy_block_lines(struct text_reader *from, struct text_reader *to)	// copies lines up to a blank line into to, which then reads them back like a file
+{
+	to->fd = NULL ;
+	to->start = 0 ;
+	to->end = 0 ;
+	to->eof = 1 ;						// never read from a file
+	to->line_count = 0 ;
+	char *line ;
+	while( (line = read_line(from)) != NULL )
 	{
-		printf("Error fixing block %s\n",strkey(node->key)) ;
-		return 1 ;
+		size_t length = strlen(line) ;
+		if( to->end + length + 1 > to->buffer_size )
+		{
+			size_t size = 2*(to->buffer_size + length + 1) ;
+			char *buffer = realloc(to->buffer,size+1) ;	// with a spare byte for the terminator of the last line
+			if( buffer == NULL )
+			{
+				printf("Cannot get memory for block text\n") ;
+				return 1 ;
+			}
+			to->buffer = buffer ;
+			to->buffer_size = size ;
+		}
+		memcpy(to->buffer+to->end,line,length) ;
+		to->end += length ;
+		to->buffer[to->end++] = 0x0a ;
+		if( length == 0 )
+			break ;					// the blank line ends the block
 	}
 	return 0 ;
 }
 
-void endian_fixup(void *original, int size)
+int write_gen_item(struct gen_pool *pool, size_t sequence, FILE *outfile, struct size_patch *patch)	// waits until the item is done, writes its node and frees the item
 {
-	if( Global_flag_little_endian )
-	{
-		unsigned char tmp[8] ;
-		memcpy(tmp,original,size) ;
-		swapcopy(original,tmp,size) ;
-	}
+	struct gen_item *item = &(pool->items[sequence % pool->window]) ;
+	pthread_mutex_lock(&pool->lock) ;
+	while( !item->done )
+		pthread_cond_wait(&pool->ready,&pool->lock) ;
+	pthread_mutex_unlock(&pool->lock) ;
+	int err = item->err ;
+	if( err )
+		printf("Error in '%s' block starting at line %ld\n",strkey(KEY_alvl),item->line_count) ;
+	for( struct node *node = item->root.next ; !err && node != NULL ; node = node->next )
+		err = write_node(node,outfile,patch) ;
+	reset_context(&(item->context)) ;
+	item->root.next = NULL ;
+	pthread_mutex_lock(&pool->lock) ;
+	pool->written++ ;
+	pthread_mutex_unlock(&pool->lock) ;
+	return err ;
 }
 
-void swapcopy(unsigned char *dest, unsigned char *source, int size)
+int write_node(struct node *node, FILE *outfile, struct size_patch *patch)	// writes one node, noting superblock header positions and sub block sizes
 {
-	switch( size )
+	struct stats_clock clock ;
+	stats_start(patch->stats,&clock) ;
+	if( patch->stats != NULL )
+		count_block(&(patch->stats->counts),node->key,node->size,patch->config.bin_type) ;
+	switch( (uint32_t )node->key )
 	{
-		case 2:
-			swapcopy2(dest,source) ;
+		case (uint32_t )KEY_AQLV:
+			patch->offset_aqlv = ftell(outfile) ;
+			patch->section = 0 ;
 		break ;
-		case 4:
-			swapcopy4(dest,source) ;
+		case (uint32_t )KEY_HEAD:
+			patch->offset_head = ftell(outfile) ;
+			patch->section = KEY_HEAD ;
 		break ;
-		case 8:
-			swapcopy8(dest,source) ;
+		case (uint32_t )KEY_BODY:
+			patch->offset_body = ftell(outfile) ;
+			patch->section = KEY_BODY ;
+		break ;
+		case (uint32_t )KEY_END:
+			patch->section = 0 ;
+		break ;
+		default:
+			if( patch->section == KEY_HEAD )
+				patch->head_size += node->size + sizeof(struct block_header) ;	// remember to count the block header
+			if( patch->section == KEY_BODY )
+				patch->body_size += node->size + sizeof(struct block_header) ;
 		break ;
 	}
+	track_config(node,&(patch->config)) ;
+	int err = gen_node(node,&(patch->config),outfile) ;
+	stats_stop(patch->stats,STATS_FORMAT,&clock) ;
+	return err ;
 }
 
-void swapcopy2(unsigned char *dest, unsigned char *source)
+int patch_sizes(struct size_patch *patch, FILE *outfile)	// overwrites the size fields of the AQVL, HEAD and BODY headers written earlier
 {
-	dest[0] = source[1] ;
-	dest[1] = source[0] ;
+	uint32_t aqlv_size = patch->head_size + sizeof(struct block_header) + patch->body_size + sizeof(struct block_header) ;
+	if( patch_block_size(outfile,patch->offset_aqlv,aqlv_size) ) return 1 ;
+	if( patch_block_size(outfile,patch->offset_head,patch->head_size) ) return 1 ;
+	if( patch_block_size(outfile,patch->offset_body,patch->body_size) ) return 1 ;
+	if( fseek(outfile,0L,SEEK_END) != 0 ) return 1 ;
+	return 0 ;
 }
 
-void swapcopy4(unsigned char *dest, unsigned char *source)
+int patch_block_size(FILE *outfile, long offset, uint32_t size)	// writes size into the header at offset, skips blocks that were never written
 {
-	dest[0] = source[3] ;
-	dest[1] = source[2] ;
-	dest[2] = source[1] ;
-	dest[3] = source[0] ;
+	if( offset < 0 ) return 0 ;
+	endian_fixup(&size,sizeof(size)) ;
+	if( fseek(outfile,offset+sizeof(fourcc),SEEK_SET) != 0 ) return 1 ;
+	if( fwrite(&size,sizeof(size),1,outfile) != 1 ) return 1 ;
+	return 0 ;
 }
 
-void swapcopy8(unsigned char *dest, unsigned char *source)
+int ts_write(struct node *list, FILE *outfile)
 {
-	dest[0] = source[7] ;
-	dest[1] = source[6] ;
-	dest[2] = source[5] ;
-	dest[3] = source[4] ;
-	dest[4] = source[3] ;
-	dest[5] = source[2] ;
-	dest[6] = source[1] ;
-	dest[7] = source[0] ;
+	//printf("debug: ts_write: start\n") ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	while( list != NULL )
+	{
+		track_config(list,&config) ;
+		if( gen_node(list,&config,outfile) )
+			return 1 ;
+		list = list->next ;
+	}
+	//printf("debug: ts_write: finish\n") ;
+	return 0 ;
 }
 
-int superblock(fourcc key)	// returns 1 if the key denotes a 'superblock', i.e. one that is composed of sub-blocks
+int gen_node(struct node *node, struct config *config, FILE *outfile)	// writes the binary version of one node to outfile, config has the bin_type of the alvl samples
 {
-	// check for one of the known superkeys
-	if( key == KEY_AQLV ) return 1 ;
-	if( key == KEY_HEAD ) return 1 ;
-	if( key == KEY_BODY ) return 1 ;
-	if( key == KEY_END ) return 1 ;
-	return 0 ;		// no, this is not a superblock key
+	fourcc key = node->key ;
+	struct block_functions *block_functions = find_block_functions(key) ;	// gets a set of functions from Global_functions_dictionary for this block type
+	if( block_functions == NULL )
+	{
+		printf("Cannot write block '%s'\n",strkey(node->key)) ;
+		return 1 ;
+	}
+	int (*gen_function)(struct node *, struct config *, FILE *) = block_functions->gen ;
+	int err = (*gen_function)(node,config,outfile) ;	// calls the 'gen' function corresponding to the block type
+	if( err )
+	{
+		printf("Error in '%s' block\n",strkey(key)) ;
+		return 1 ;
+	}
+	return 0 ;
 }
 
-void hexdump(unsigned char *buffer, int n)
+char *read_line(struct text_reader *reader)	// returns the next line without its newline, valid until the next call, or NULL at the end of the file
 {
-	for( int row = 0 ; row <= n/8 ; row++ )
+	while( 1 )
 	{
-		for( int col = 0 ; col < 8 ; col++ )
+		char *start = reader->buffer + reader->start ;
+		size_t pending = reader->end - reader->start ;
+		char *nl = ( pending > 0 ) ? memchr(start,0x0a,pending) : NULL ;
+		if( nl != NULL )
 		{
-			int offset = row*8+col ;
-			if( offset < n )
-			{
-				printf("%02x ",buffer[offset]) ;
-			}
-			else
-			{
-				printf("   ") ;
-			}
+			*nl = '\0' ;
+			reader->start = (nl + 1) - reader->buffer ;
+			reader->line_count++ ;
+			return start ;
 		}
-		printf("\t") ;
-		for( int col = 0 ; col < 8 ; col++ )
+		if( reader->eof )
 		{
-			int offset = row*8+col ;
-			if( offset < n )
-			{
-				if( isprint(buffer[offset]) )
-					printf("%c",buffer[offset]) ;
-				else
-					printf(".") ;
-			}
-			else
+			if( pending == 0 ) return NULL ;
+			start[pending] = '\0' ;			// last line has no newline, there is always a spare byte
+			reader->start = reader->end ;
+			reader->line_count++ ;
+			return start ;
+		}
+		if( reader->start > 0 )				// move the partial line to the front of the buffer
+		{
+			memmove(reader->buffer,start,pending) ;
+			reader->start = 0 ;
+			reader->end = pending ;
+		}
+		if( reader->end == reader->buffer_size )	// a line longer than the buffer (or the first read), grow it
+		{
+			size_t size = reader->buffer_size ? 2*reader->buffer_size : SIZE_READ_BUFFER ;
+			char *buffer = realloc(reader->buffer,size+1) ;
+			if( buffer == NULL )
 			{
-				printf("   ") ;
+				printf("Cannot get memory for text buffer\n") ;
+				return NULL ;
 			}
+			reader->buffer = buffer ;
+			reader->buffer_size = size ;
 		}
-		printf("\n") ;
+		size_t count = fread(reader->buffer+reader->end,1,reader->buffer_size-reader->end,reader->fd) ;
+		if( count == 0 )
+			reader->eof = 1 ;
+		reader->end += count ;
 	}
 }
 
-#define MAX_NAME 10
-char Global_name[MAX_NAME] ;
-char *strkey(fourcc name)
-{
-	int size = sizeof(name) ;
-	if( size >= MAX_NAME )
-		size = MAX_NAME-1 ;
-	memcpy(Global_name,(void *)&name,size) ;
-	endian_fixup(Global_name,size) ;
-	Global_name[size] = '\0' ;
-	return Global_name ;
-}
-
-int fixup_sizes(struct node *list)
+int read_block(struct text_reader *reader)	// copies the parameter lines of a block, up to the blank line that ends it, so they can be looked up in any order
 {
-	uint32_t head_size = calculate_head_size(list) ;
-	if( head_size == 0 ) return 1 ;
-	uint32_t body_size = calculate_body_size(list) ;
-	if( body_size == 0 ) return 1 ;
-	uint32_t aqlv_size = head_size + sizeof(struct block_header) + body_size + sizeof(struct block_header) ;
-	if( set_block_size(list,KEY_AQLV,aqlv_size) ) return 1 ;
-	if( set_block_size(list,KEY_HEAD,head_size) ) return 1 ;
-	if( set_block_size(list,KEY_BODY,body_size) ) return 1 ;
+	reader->block_length = 0 ;
+	char *line ;
+	while( (line = read_line(reader)) != NULL )
+	{
+		size_t length = strlen(line) ;
+		if( length == 0 )
+			break ;				// stop on blank line
+		if( reader->block_length + length + 1 > reader->block_size )
+		{
+			size_t size = 2*(reader->block_size + length + 1) ;
+			char *block = realloc(reader->block,size) ;
+			if( block == NULL )
+			{
+				printf("Cannot get memory for block text\n") ;
+				return 1 ;
+			}
+			reader->block = block ;
+			reader->block_size = size ;
+		}
+		memcpy(reader->block+reader->block_length,line,length+1) ;
+		reader->block_length += length + 1 ;
+	}
 	return 0 ;
 }
 
-uint32_t calculate_body_size(struct node *list)			// returns the size of the blocks in the BODY superblock
+int read_parameter(struct text_reader *reader, char format[], void *buffer)	// looks for a line of the current block with format, copies the value to buffer
 {
-	int in_body = 0 ;
-	uint32_t size = 0 ;
-	while( list != NULL )
+	//printf("debug: read_parameters: format='%s'\n",format) ;
+	for( size_t offset = 0 ; offset < reader->block_length ; offset += strlen(reader->block+offset) + 1 )
 	{
-		if( list->key == KEY_END )
-			in_body = 0 ;
-		if( in_body )
-			size += ( list->size + sizeof(struct block_header) ) ;	// remember to count the block header
-		if( list->key == KEY_BODY )
-			in_body = 1 ;
-		list = list->next ;
-	} ;
-	return size ;
+		char *line = reader->block + offset ;
+		int count = sscanf(line,format,buffer) ;
+		if( count > 0 )
+			return 0 ;
+	}
+	printf("Cannot find parameter '%s'\n",format) ;
+	return 1 ;
 }
 
-uint32_t calculate_head_size(struct node *list)			// returns the size of the blocks in the HEAD superblock
+static const double Powers_of_ten[] =
 {
-	int in_head = 0 ;
-	uint32_t size = 0 ;
-	while( list != NULL )
-	{
-		if( list->key == KEY_END )
-			in_head = 0 ;
-		if( list->key == KEY_BODY )
-			in_head = 0 ;
-		if( in_head )
-			size += (list->size + sizeof(struct block_header) ) ;	// remember to count the block header
-		if( list->key == KEY_HEAD )
-			in_head = 1 ;
-		list = list->next ;
-	} ;
-	return size ;
-}
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+} ;
 
-int set_block_size(struct node *list, fourcc key, uint32_t size)	// returns 1 for failure, 0 for success
+double parse_double(char *text, char **end)	// fast parser for plain decimal numbers as written by tsdump, anything else goes to strtod()
 {
-	while( list != NULL )
+	char *p = text ;
+	int negative = 0 ;
+	if( *p == '-' || *p == '+' )
+		negative = ( *p++ == '-' ) ;
+	uint64_t mantissa = 0 ;
+	int digits = 0 ;			// significant digits held in mantissa, at most 19 fit
+	int exponent = 0 ;			// power of ten to apply to mantissa
+	int dropped = 0 ;			// digits past the 19th, which make mantissa inexact
+	char *first = p ;
+	for( ; *p >= '0' && *p <= '9' ; p++ )
 	{
-		if( list->key == key )
+		if( digits < 19 )
 		{
-			list->size = size ;
-			return 0 ;
+			mantissa = mantissa*10 + (*p - '0') ;
+			if( mantissa ) digits++ ;
+		}
+		else
+		{
+			exponent++ ;		// integer digits that do not fit still count
+			dropped = 1 ;
 		}
-		list = list->next ;
 	}
-	return 1 ;
+	if( *p == '.' )
+	{
+		for( p++ ; *p >= '0' && *p <= '9' ; p++ )
+		{
+			if( digits < 19 )
+			{
+				mantissa = mantissa*10 + (*p - '0') ;
+				if( mantissa ) digits++ ;
+				exponent-- ;
+			}
+			else
+				dropped = 1 ;
+		}
+	}
+	if( p == first || *p == 'e' || *p == 'E' || dropped || exponent < -22 || exponent > 22
+		|| (mantissa > (1ULL << 53) && (exponent < -19 || exponent > 19)) )
+		return strtod(text,end) ;	// exponents, inf, nan, extreme values and more digits than can be rounded here
+	double value ;
+	if( mantissa <= (1ULL << 53) )		// exact, as is the power of ten, so the one multiply or divide rounds correctly
+		value = ( exponent < 0 ) ? (double )mantissa / Powers_of_ten[-exponent] : (double )mantissa * Powers_of_ten[exponent] ;
+	else if( exponent >= 0 )		// 17 to 19 digits, as format_double() writes: the exact product or quotient in 128 bits, rounded once
+		value = (double )((unsigned __int128 )mantissa * (uint64_t )Powers_of_ten[exponent]) ;
+	else
+	{
+		uint64_t power = (uint64_t )Powers_of_ten[-exponent] ;
+		int shift = 64 + __builtin_clzll(mantissa) ;	// puts the top bit of mantissa at bit 127, so the quotient has at least 64 bits
+		unsigned __int128 numerator = (unsigned __int128 )mantissa << shift ;
+		unsigned __int128 quotient = numerator / power ;
+		quotient |= ( quotient*power != numerator ) ;	// a sticky bit for the remainder, well below the 53 bits kept
+		uint64_t bits = (uint64_t )(1023 - shift) << 52 ;	// 2^-shift, so the scaling is exact
+		double scale ;
+		memcpy(&scale,&bits,sizeof(scale)) ;
+		value = (double )quotient * scale ;
+	}
+	*end = p ;
+	return negative ? -value : value ;
 }
 
-void show_list(struct node *list)
+#define SIZE_NUMBER 48			// longest text format_double() writes, with its terminator
+#define SIZE_TEXT_BUFFER (64*1024)	// size of the buffer dump_block_alvl() formats lines into
+#define COUNTS_PER_LINE 16		// I/Q pairs on each line of a compact alvl block
+
+int format_double(double value, char *text)	// writes the shortest decimal that reads back as the same double, returns its length
 {
-	unsigned int count = 0 ;
-	while( list != NULL )
+	// This is the digit search of the Ryu algorithm (Ulf Adams, 2018), with the products computed
+	// exactly in 128 bits instead of from tables. That covers magnitudes from about 1e-13 to 1e30,
+	// anything outside falls back to printf, which also round trips with 17 digits. The text reads
+	// back as the same double through strtod() and through parse_double(), which rounds correctly too.
+	uint64_t bits ;
+	memcpy(&bits,&value,sizeof(bits)) ;
+	int biased = (bits >> 52) & 0x7ff ;
+	uint64_t fraction = bits & ((1ULL << 52) - 1) ;
+	if( biased == 0x7ff )
+		return sprintf(text,"%.17g",value) ;	// inf or nan
+	char *p = text ;
+	if( bits >> 63 )
+		*p++ = '-' ;
+	if( biased == 0 && fraction == 0 )
 	{
-		printf("Node %u: key %.4s size %u\n",count,(char *)&(list->key),list->size) ;
-		list = list->next ;
-		count++ ;
+		*p++ = '0' ;
+		*p = '\0' ;
+		return p - text ;
+	}
+	uint64_t m2 = ( biased == 0 ) ? fraction : fraction | (1ULL << 52) ;
+	int e2 = ( biased == 0 ) ? 1 - 1075 : biased - 1075 ;
+	int mmshift = ( fraction != 0 || biased <= 1 ) ;	// the gap below a power of two is half the gap above
+	uint64_t mv = 4*m2 ;					// the value and the halfway points to its neighbours, times 4
+	uint64_t mp = 4*m2 + 2 ;
+	uint64_t mm = 4*m2 - 1 - mmshift ;
+	e2 -= 2 ;
+	uint64_t vr, vp, vm ;					// the same three, scaled to a decimal exponent e10 and truncated
+	int e10 ;
+	int vr_exact, vp_exact ;
+	if( e2 >= 0 )
+	{
+		int q = ((e2*78913) >> 18) - ( e2 > 3 ) ;	// floor(log10(2^e2)), minus one to keep a guard digit
+		if( e2 - q > 72 )
+			return sprintf(text,"%.17g",value) ;
+		unsigned __int128 pow5 = 1 ;
+		for( int loop = 0 ; loop < q ; loop++ ) pow5 *= 5 ;
+		unsigned __int128 r = ((unsigned __int128 )mv << (e2 - q)) ;
+		unsigned __int128 u = ((unsigned __int128 )mp << (e2 - q)) ;
+		vr = r/pow5 ; vr_exact = ( r%pow5 == 0 ) ;
+		vp = u/pow5 ; vp_exact = ( u%pow5 == 0 ) ;
+		vm = ((unsigned __int128 )mm << (e2 - q))/pow5 ;
+		e10 = q ;
+	}
+	else
+	{
+		int q = ((-e2*732923) >> 20) - ( -e2 > 1 ) ;	// floor(log10(5^-e2)), minus one to keep a guard digit
+		int k = -e2 - q ;				// multiply by 10^k = 5^k * 2^k, then divide by 2^-e2
+		if( k > 31 )
+			return sprintf(text,"%.17g",value) ;
+		unsigned __int128 pow5 = 1 ;
+		for( int loop = 0 ; loop < k ; loop++ ) pow5 *= 5 ;
+		unsigned __int128 mask = ( q < 128 ) ? ((unsigned __int128 )1 << q) - 1 : ~(unsigned __int128 )0 ;
+		unsigned __int128 r = mv*pow5 ;
+		unsigned __int128 u = mp*pow5 ;
+		vr = r >> q ; vr_exact = ( (r & mask) == 0 ) ;
+		vp = u >> q ; vp_exact = ( (u & mask) == 0 ) ;
+		vm = (mm*pow5) >> q ;
+		e10 = -k ;
+	}
+	if( vp_exact )
+		vp-- ;			// the upper halfway point itself does not read back as value
+	int removed = 0 ;
+	int last_digit = 0 ;
+	while( vp/10 > vm/10 )		// drop digits while a shorter number still lies between the halfway points
+	{
+		vr_exact &= ( last_digit == 0 ) ;
+		last_digit = vr%10 ;
+		vr /= 10 ;
+		vp /= 10 ;
+		vm /= 10 ;
+		removed++ ;
+	}
+	if( vr_exact && last_digit == 5 && vr%2 == 0 )
+		last_digit = 4 ;	// exactly halfway, round to even
+	uint64_t output = vr + ( vr == vm || last_digit >= 5 ) ;
+	int exponent = e10 + removed ;
+	char digits[24] ;
+	int ndigits = 0 ;
+	for( ; output > 0 ; output /= 10 )
+		digits[ndigits++] = '0' + output%10 ;	// least significant first
+	int point = ndigits + exponent ;		// digits before the decimal point
+	if( point > 21 || point < -20 )			// too long in plain notation, use an exponent
+	{
+		*p++ = digits[--ndigits] ;
+		if( ndigits > 0 )
+		{
+			*p++ = '.' ;
+			while( ndigits > 0 ) *p++ = digits[--ndigits] ;
+		}
+		p += sprintf(p,"e%d",point-1) ;
+		return p - text ;
+	}
+	if( point <= 0 )
+	{
+		*p++ = '0' ;
+		*p++ = '.' ;
+		for( ; point < 0 ; point++ ) *p++ = '0' ;
+		while( ndigits > 0 ) *p++ = digits[--ndigits] ;
+	}
+	else
+	{
+		for( int loop = 0 ; loop < point ; loop++ )
+			*p++ = ( ndigits > 0 ) ? digits[--ndigits] : '0' ;
+		if( ndigits > 0 )
+		{
+			*p++ = '.' ;
+			while( ndigits > 0 ) *p++ = digits[--ndigits] ;
+		}
+	}
+	*p = '\0' ;
+	return p - text ;
+}
+
+unsigned char *read_binary_file(FILE *tsfile, unsigned long *filesize)	// reads to the end of the file into a buffer that grows as needed, so pipes work too
+{
+	unsigned long size = 0 ;
+	unsigned long allocated = 1024*1024 ;
+	unsigned char *buffer = malloc(allocated) ;
+	while( buffer != NULL )
+	{
+		size += fread(buffer+size,1,allocated-size,tsfile) ;
+		if( size < allocated ) break ;		// end of file or an error, ferror() tells
+		unsigned char *more = realloc(buffer,2*allocated) ;
+		if( more == NULL )
+		{
+			free(buffer) ;
+			buffer = NULL ;
+			break ;
+		}
+		buffer = more ;
+		allocated *= 2 ;
+	}
+	if( buffer == NULL )
+	{
+		printf("Cannot get memory for file with more than %lu bytes\n",size) ;
+		return NULL ;
+	}
+	if( ferror(tsfile) )
+	{
+		printf("Error reading ts file after %lu bytes\n",size) ;
+		free(buffer) ;
+		return NULL ;
+	}
+	if( size > sizeof(struct block_header) && check_header(buffer) )
+	{
+		free(buffer) ;
+		return NULL ;
+	}
+	*filesize = size ;
+	return buffer ;
+}
+
+int check_header(unsigned char *buffer)
+{
+	struct block_header *header = (struct block_header *)buffer ;
+	fourcc key = header->key ;
+	endian_fixup(&key,sizeof(key)) ;
+	//printf("debug: check_header: read %x as %x\n",header->key,key) ;
+	if( key != KEY_AQLV )
+	{
+		printf("Bad header key: %x\n",key) ;
+		return 1 ;
+	}
+	// TODO check file size (meh?)
+	return 0 ;
+}
+
+struct node *parse_file(struct parse_context *context, unsigned char *buffer, unsigned long length)
+{
+	struct node dummy_root ;	// use a dummy root node to prime the parser
+	memset(&dummy_root,0,sizeof(struct node)) ;
+	if( parse_block(context,&dummy_root,buffer,length) )
+	{
+		printf("Parser error\n") ;
+		return NULL ;
+	}
+	return dummy_root.next ;	// return the next node as the true root
+}
+
+int parse_block(struct parse_context *context, struct node *root, unsigned char *buffer, unsigned long length)	// links a node for every block in buffer after root
+{
+	struct parse_state state ;
+	state.context = context ;
+	state.tail = root ;
+	struct ts_events events ;
+	memset(&events,0,sizeof(struct ts_events)) ;
+	events.enter = parse_data ;				// a superblock gets a node too, its sub blocks follow it in the list
+	events.block = parse_data ;
+	events.user = &state ;
+	return walk_blocks(&events,buffer,length,&(context->config),context->stats) ;
+}
+
+int parse_data(void *user, uint32_t key, void *data, uint32_t size)
+{
+	struct parse_state *state = (struct parse_state *)user ;
+	struct node *newnode = new_node(state->context,state->tail,key) ;
+	if( newnode == NULL )
+		return 1 ;
+	newnode->size = size ;
+	newnode->data = data ;					// point at the data portion of the block, in the caller's buffer
+	state->tail = newnode ;
+	return 0 ;
+}
+
+int walk_blocks(struct ts_events *events, unsigned char *buffer, unsigned long length, struct config *config, struct run_stats *stats)	// calls back for every block in buffer, fixing up data blocks in place, allocates nothing
+{
+	while( length > 0 )
+	{
+		if( length < sizeof(struct block_header) )
+		{
+			printf("Error reading ts file, truncated block header\n") ;
+			return 1 ;
+		}
+		struct node block ;					// describes the block to fixup_data(), lives on the stack
+		memset(&block,0,sizeof(struct node)) ;
+		memcpy(&(block.key),buffer,sizeof(block.key)) ;	// the buffer is left as it is, the header is copied and fixed up
+		memcpy(&(block.size),buffer+sizeof(block.key),sizeof(block.size)) ;
+		endian_fixup(&(block.key),sizeof(block.key)) ;
+		endian_fixup(&(block.size),sizeof(block.size)) ;
+		length -= sizeof(struct block_header) ;			// reduce the block length by the size of the header
+		buffer += sizeof(struct block_header) ;			// advance the buffer pointer by the size of the header
+		if( block.size > length )
+		{
+			printf("Block '%s' size truncted from %u to %lu bytes\n",strkey(block.key),block.size,length) ;
+			block.size = length ;
+		}
+		block.data = buffer ;
+		if( stats != NULL )
+			count_block(&(stats->counts),block.key,block.size,config->bin_type) ;
+		int err = 0 ;
+		if( superblock(block.key) )				// if the block is a superblock, walk its sub blocks between enter and leave
+		{
+			if( events->enter != NULL && (err = (*events->enter)(events->user,block.key,block.data,block.size)) )
+				return err ;
+			if( (err = walk_blocks(events,block.data,block.size,config,stats)) )
+				return err ;
+			if( events->leave != NULL && (err = (*events->leave)(events->user,block.key)) )
+				return err ;
+		}
+		else
+		{
+			struct stats_clock clock ;
+			stats_start(stats,&clock) ;
+			if( fixup_data(&block,config) )			// otherwise, do endian fixup on the block's data
+			{
+				if( stats != NULL ) stats->counts.count_bad++ ;
+				return 1 ;
+			}
+			stats_stop(stats,STATS_FIXUP,&clock) ;
+			track_config(&block,config) ;			// the fbin block sets the width of the alvl blocks after it
+			if( events->block != NULL && (err = (*events->block)(events->user,block.key,block.data,block.size)) )
+				return err ;
+		}
+		length -= block.size ;					// move on to the next block in the buffer
+		buffer += block.size ;
+	}
+	return 0 ;
+}
+
+struct block_functions Global_function_dictionary[] =		// a dictionary of  names and associated functions, used to lookup which function to call
+{
+	{ KEY_alvl, fixup_data_alvl, make_node_alvl, dump_block_alvl, gen_block_alvl  },
+	{ KEY_gtag, fixup_data_gtag, make_node_gtag, dump_block_gtag, gen_block_gtag  },
+	{ KEY_atag, fixup_data_atag, make_node_atag, dump_block_atag, gen_block_atag  },
+	{ KEY_indx, fixup_data_indx, make_node_indx, dump_block_indx, gen_block_indx  },
+	{ KEY_scal, fixup_data_scal, make_node_scal, dump_block_scal, gen_block_scal  },
+	{ KEY_sign, fixup_data_sign, make_node_sign, dump_block_sign, gen_block_sign  },
+	{ KEY_mcda, fixup_data_mcda, make_node_mcda, dump_block_mcda, gen_block_mcda  },
+	{ KEY_cnst, fixup_data_cnst, make_node_cnst, dump_block_cnst, gen_block_cnst  },
+	{ KEY_swep, fixup_data_swep, make_node_swep, dump_block_swep, gen_block_swep  },
+	{ KEY_fbin, fixup_data_fbin, make_node_fbin, dump_block_fbin, gen_block_fbin  },
+	{ KEY_AQLV, fixup_data_aqlv, make_node_aqlv, dump_block_aqlv, gen_block_aqlv  },
+	{ KEY_HEAD, fixup_data_head, make_node_head, dump_block_head, gen_block_head  },
+	{ KEY_BODY, fixup_data_body, make_node_body, dump_block_body, gen_block_body  },
+	{ KEY_END, fixup_data_end, make_node_end, dump_block_end, gen_block_end  },
+	{ 0, NULL, NULL, NULL, NULL }
+} ;
+
+struct block_functions *find_block_functions(fourcc key)
+{
+	if( key == 0 )
+	{
+		printf("Bad key (zero!)\n") ;
+		return NULL ;
+	}
+	for( struct block_functions *block_functions = Global_function_dictionary ; block_functions->key != 0 ; block_functions++ )
+	{
+		if( key == block_functions->key )
+			return block_functions ;
+	}
+	printf("Cannot locate functions for key '%s'\n",strkey(key)) ;
+	return NULL ;
+}
+
+int fixup_data(struct node *node, struct config *config)	// figures out what type of block and what to do with it, config has the bin_type of the alvl samples
+{
+	struct block_functions *block_functions = find_block_functions(node->key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
+	if( block_functions == NULL )
+	{
+		printf("Cannot fixup block '%s'\n",strkey(node->key)) ;
+		return 1 ;
+	}
+	int (*fixup_function)(struct node *, struct config *) = block_functions->fixup ;
+	int err = (*fixup_function)(node,config) ;	// calls the fixup function corresponding to the block key
+	if( err )
+	{
+		printf("Error fixing block %s\n",strkey(node->key)) ;
+		return 1 ;
+	}
+	return 0 ;
+}
+
+void endian_fixup(void *original, int size)
+{
+	if( HOST_LITTLE_ENDIAN )
+	{
+		unsigned char tmp[8] ;
+		memcpy(tmp,original,size) ;
+		swapcopy(original,tmp,size) ;
+	}
+}
+
+void swapcopy(unsigned char *dest, unsigned char *source, int size)
+{
+	switch( size )
+	{
+		case 2:
+			swapcopy2(dest,source) ;
+		break ;
+		case 4:
+			swapcopy4(dest,source) ;
+		break ;
+		case 8:
+			swapcopy8(dest,source) ;
+		break ;
+	}
+}
+
+void swapcopy2(unsigned char *dest, unsigned char *source)
+{
+	dest[0] = source[1] ;
+	dest[1] = source[0] ;
+}
+
+void swapcopy4(unsigned char *dest, unsigned char *source)
+{
+	dest[0] = source[3] ;
+	dest[1] = source[2] ;
+	dest[2] = source[1] ;
+	dest[3] = source[0] ;
+}
+
+void swapcopy8(unsigned char *dest, unsigned char *source)
+{
+	dest[0] = source[7] ;
+	dest[1] = source[6] ;
+	dest[2] = source[5] ;
+	dest[3] = source[4] ;
+	dest[4] = source[3] ;
+	dest[5] = source[2] ;
+	dest[6] = source[1] ;
+	dest[7] = source[0] ;
+}
+
+struct swap_kernel Global_swap_kernels[] =		// fastest first, the scalar kernel runs anywhere
+{
+#ifdef HAVE_X86_SIMD
+	{ "avx2", swap_supported_avx2, swap16_avx2, swap24_ssse3, swap32_avx2, power16_avx2, unpack16_ssse3 },	// 24 bit values and packed rows fit 128 bits, AVX2 has nothing to add
+	{ "ssse3", swap_supported_ssse3, swap16_ssse3, swap24_ssse3, swap32_ssse3, power16_ssse3, unpack16_ssse3 },
+#endif
+	{ "scalar", swap_supported_always, swap16_scalar, swap24_scalar, swap32_scalar, power16_scalar, unpack16_scalar },
+	{ NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+} ;
+
+struct swap_kernel *swap_kernel(void)	// returns the kernel to use, chosen on first use by whichever thread gets there first
+{
+	pthread_once(&Global_swap_once,choose_swap_kernel) ;
+	return Global_swap_kernel ;
+}
+
+void choose_swap_kernel(void)
+{
+	Global_swap_kernel = select_swap_kernel() ;
+}
+
+struct swap_kernel *select_swap_kernel(void)	// returns the first kernel in Global_swap_kernels that this cpu supports
+{
+	struct swap_kernel *kernel = Global_swap_kernels ;
+	while( !(*kernel->supported)() )
+		kernel++ ;
+	return kernel ;
+}
+
+int swap_supported_always(void)
+{
+	return 1 ;
+}
+
+void swap16_scalar(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	for( size_t loop = 0 ; loop < count ; loop++, p += 2 )
+	{
+		uint16_t value ;
+		memcpy(&value,p,sizeof(value)) ;	// the data need not be aligned
+		value = __builtin_bswap16(value) ;
+		memcpy(p,&value,sizeof(value)) ;
+	}
+}
+
+void swap24_scalar(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	for( size_t loop = 0 ; loop < count ; loop++, p += 3 )
+	{
+		unsigned char first = p[0] ;		// the middle byte stays where it is
+		p[0] = p[2] ;
+		p[2] = first ;
+	}
+}
+
+void swap32_scalar(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	for( size_t loop = 0 ; loop < count ; loop++, p += 4 )
+	{
+		uint32_t value ;
+		memcpy(&value,p,sizeof(value)) ;
+		value = __builtin_bswap32(value) ;
+		memcpy(p,&value,sizeof(value)) ;
+	}
+}
+
+void unpack16_scalar(const unsigned char *in, int width, uint16_t *previous, unsigned char *out, size_t count)	// the first count of a group of PACK_GROUP samples, previous holds the last I and Q
+{
+	uint16_t zigzag[PACK_GROUP] ;
+	unpack_group(in,width,zigzag) ;
+	unzigzag_group(zigzag,count,previous,out) ;
+}
+
+void power16_scalar(const void *data, size_t count, struct power_sum *sum)
+{
+	const unsigned char *p = data ;
+	for( size_t loop = 0 ; loop < count ; loop++, p += 2 )
+	{
+		int value = (int16_t )((p[0] << 8) | p[1]) ;	// big endian
+		sum->sum_squares += value*value ;
+		if( value > sum->maximum ) sum->maximum = value ;
+		if( value < sum->minimum ) sum->minimum = value ;
+	}
+}
+
+#ifdef HAVE_X86_SIMD
+int swap_supported_ssse3(void)
+{
+	return __builtin_cpu_supports("ssse3") ;
+}
+
+int swap_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2") ;
+}
+
+__attribute__((target("ssse3")))
+void swap16_ssse3(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	const __m128i mask = _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) ;
+	size_t loop = 0 ;
+	for( ; loop + 8 <= count ; loop += 8, p += 16 )
+		_mm_storeu_si128((__m128i *)p,_mm_shuffle_epi8(_mm_loadu_si128((__m128i *)p),mask)) ;
+	swap16_scalar(p,count-loop) ;		// the odd values at the end
+}
+
+__attribute__((target("ssse3")))
+void swap24_ssse3(void *data, size_t count)	// 16 values in three vectors, a value can straddle two of them so each result is put together from its neighbours
+{
+	unsigned char *p = data ;
+	const __m128i mask_00 = _mm_setr_epi8(2,1,0,5,4,3,8,7,6,11,10,9,14,13,12,-128) ;	// mask_ab takes the bytes of result a from vector b
+	const __m128i mask_01 = _mm_setr_epi8(-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,1) ;
+	const __m128i mask_10 = _mm_setr_epi8(-128,15,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128) ;
+	const __m128i mask_11 = _mm_setr_epi8(0,-128,4,3,2,7,6,5,10,9,8,13,12,11,-128,15) ;
+	const __m128i mask_12 = _mm_setr_epi8(-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,0,-128) ;
+	const __m128i mask_21 = _mm_setr_epi8(14,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128,-128) ;
+	const __m128i mask_22 = _mm_setr_epi8(-128,3,2,1,6,5,4,9,8,7,12,11,10,15,14,13) ;
+	size_t loop = 0 ;
+	for( ; loop + 16 <= count ; loop += 16, p += 48 )
+	{
+		__m128i a = _mm_loadu_si128((__m128i *)p) ;
+		__m128i b = _mm_loadu_si128((__m128i *)(p+16)) ;
+		__m128i c = _mm_loadu_si128((__m128i *)(p+32)) ;
+		_mm_storeu_si128((__m128i *)p,_mm_or_si128(_mm_shuffle_epi8(a,mask_00),_mm_shuffle_epi8(b,mask_01))) ;
+		_mm_storeu_si128((__m128i *)(p+16),_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a,mask_10),_mm_shuffle_epi8(b,mask_11)),_mm_shuffle_epi8(c,mask_12))) ;
+		_mm_storeu_si128((__m128i *)(p+32),_mm_or_si128(_mm_shuffle_epi8(b,mask_21),_mm_shuffle_epi8(c,mask_22))) ;
+	}
+	swap24_scalar(p,count-loop) ;
+}
+
+__attribute__((target("ssse3")))
+void swap32_ssse3(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	const __m128i mask = _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12) ;
+	size_t loop = 0 ;
+	for( ; loop + 4 <= count ; loop += 4, p += 16 )
+		_mm_storeu_si128((__m128i *)p,_mm_shuffle_epi8(_mm_loadu_si128((__m128i *)p),mask)) ;
+	swap32_scalar(p,count-loop) ;
+}
+
+__attribute__((target("ssse3")))
+void power16_ssse3(const void *data, size_t count, struct power_sum *sum)
+{
+	const unsigned char *p = data ;
+	const __m128i mask = _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) ;
+	const __m128i zero = _mm_setzero_si128() ;
+	__m128i total = zero ;				// two 64 bit sums
+	__m128i maximum = zero ;
+	__m128i minimum = zero ;
+	size_t loop = 0 ;
+	for( ; loop + 8 <= count ; loop += 8, p += 16 )
+	{
+		__m128i values = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p),mask) ;
+		__m128i squares = _mm_madd_epi16(values,values) ;	// pairs of squares, at most 2^31 so they are added as unsigned
+		total = _mm_add_epi64(total,_mm_unpacklo_epi32(squares,zero)) ;
+		total = _mm_add_epi64(total,_mm_unpackhi_epi32(squares,zero)) ;
+		maximum = _mm_max_epi16(maximum,values) ;
+		minimum = _mm_min_epi16(minimum,values) ;
+	}
+	uint64_t totals[2] ;
+	int16_t maximums[8] ;
+	int16_t minimums[8] ;
+	_mm_storeu_si128((__m128i *)totals,total) ;
+	_mm_storeu_si128((__m128i *)maximums,maximum) ;
+	_mm_storeu_si128((__m128i *)minimums,minimum) ;
+	sum->sum_squares += totals[0] + totals[1] ;
+	for( int lane = 0 ; lane < 8 ; lane++ )
+	{
+		if( maximums[lane] > sum->maximum ) sum->maximum = maximums[lane] ;
+		if( minimums[lane] < sum->minimum ) sum->minimum = minimums[lane] ;
+	}
+	power16_scalar(p,count-loop,sum) ;		// the odd values at the end
+}
+
+__attribute__((target("ssse3")))
+void unpack16_ssse3(const unsigned char *in, int width, uint16_t *previous, unsigned char *out, size_t count)	// one row of PACK_LANES samples, 4 I/Q pairs, per vector
+{
+	const __m128i swap = _mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) ;
+	const __m128i mask = _mm_set1_epi16((short )((1u << width) - 1)) ;
+	const __m128i one = _mm_set1_epi16(1) ;
+	__m128i last = _mm_set1_epi32(previous[0] | (uint32_t )previous[1] << 16) ;	// the last I and Q, in every pair
+	for( size_t row = 0 ; row*PACK_LANES < count ; row++ )
+	{
+		__m128i value = _mm_setzero_si128() ;
+		if( width > 0 )
+		{
+			int bit = row * width ;
+			int shift = bit % 16 ;
+			const __m128i *word = (const __m128i *)(in + (bit/16)*16) ;
+			value = _mm_srl_epi16(_mm_shuffle_epi8(_mm_loadu_si128(word),swap),_mm_cvtsi32_si128(shift)) ;	// the lane words are big endian
+			if( shift + width > 16 )
+				value = _mm_or_si128(value,_mm_sll_epi16(_mm_shuffle_epi8(_mm_loadu_si128(word+1),swap),_mm_cvtsi32_si128(16-shift))) ;
+			value = _mm_and_si128(value,mask) ;
+		}
+		value = _mm_xor_si128(_mm_srli_epi16(value,1),_mm_sub_epi16(_mm_setzero_si128(),_mm_and_si128(value,one))) ;	// zigzag back to differences
+		value = _mm_add_epi16(value,_mm_slli_si128(value,4)) ;	// running sums of the I and of the Q differences
+		value = _mm_add_epi16(value,_mm_slli_si128(value,8)) ;
+		value = _mm_add_epi16(value,last) ;
+		last = _mm_shuffle_epi32(value,0xff) ;
+		value = _mm_shuffle_epi8(value,swap) ;
+		if( count - row*PACK_LANES >= PACK_LANES )
+			_mm_storeu_si128((__m128i *)(out + row*16),value) ;
+		else
+		{
+			unsigned char tail[16] ;		// the samples at the end of the block
+			_mm_storeu_si128((__m128i *)tail,value) ;
+			memcpy(out+row*16,tail,(count-row*PACK_LANES)*sizeof(int16_t)) ;
+		}
+	}
+	uint32_t pair = _mm_cvtsi128_si32(last) ;
+	previous[0] = pair ;
+	previous[1] = pair >> 16 ;
+}
+
+__attribute__((target("avx2")))
+void swap16_avx2(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	const __m256i mask = _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) ;
+	size_t loop = 0 ;
+	for( ; loop + 16 <= count ; loop += 16, p += 32 )
+		_mm256_storeu_si256((__m256i *)p,_mm256_shuffle_epi8(_mm256_loadu_si256((__m256i *)p),mask)) ;
+	swap16_scalar(p,count-loop) ;
+}
+
+__attribute__((target("avx2")))
+void swap32_avx2(void *data, size_t count)
+{
+	unsigned char *p = data ;
+	const __m256i mask = _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12) ;
+	size_t loop = 0 ;
+	for( ; loop + 8 <= count ; loop += 8, p += 32 )
+		_mm256_storeu_si256((__m256i *)p,_mm256_shuffle_epi8(_mm256_loadu_si256((__m256i *)p),mask)) ;
+	swap32_scalar(p,count-loop) ;
+}
+
+__attribute__((target("avx2")))
+void power16_avx2(const void *data, size_t count, struct power_sum *sum)
+{
+	const unsigned char *p = data ;
+	const __m256i mask = _mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14) ;
+	const __m256i zero = _mm256_setzero_si256() ;
+	__m256i total = zero ;				// four 64 bit sums
+	__m256i maximum = zero ;
+	__m256i minimum = zero ;
+	size_t loop = 0 ;
+	for( ; loop + 16 <= count ; loop += 16, p += 32 )
+	{
+		__m256i values = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)p),mask) ;
+		__m256i squares = _mm256_madd_epi16(values,values) ;
+		total = _mm256_add_epi64(total,_mm256_unpacklo_epi32(squares,zero)) ;
+		total = _mm256_add_epi64(total,_mm256_unpackhi_epi32(squares,zero)) ;
+		maximum = _mm256_max_epi16(maximum,values) ;
+		minimum = _mm256_min_epi16(minimum,values) ;
+	}
+	uint64_t totals[4] ;
+	int16_t maximums[16] ;
+	int16_t minimums[16] ;
+	_mm256_storeu_si256((__m256i *)totals,total) ;
+	_mm256_storeu_si256((__m256i *)maximums,maximum) ;
+	_mm256_storeu_si256((__m256i *)minimums,minimum) ;
+	sum->sum_squares += totals[0] + totals[1] + totals[2] + totals[3] ;
+	for( int lane = 0 ; lane < 16 ; lane++ )
+	{
+		if( maximums[lane] > sum->maximum ) sum->maximum = maximums[lane] ;
+		if( minimums[lane] < sum->minimum ) sum->minimum = minimums[lane] ;
+	}
+	power16_scalar(p,count-loop,sum) ;
+}
+#endif
+
+int superblock(fourcc key)	// returns 1 if the key denotes a 'superblock', i.e. one that is composed of sub-blocks
+{
+	// check for one of the known superkeys
+	if( key == KEY_AQLV ) return 1 ;
+	if( key == KEY_HEAD ) return 1 ;
+	if( key == KEY_BODY ) return 1 ;
+	if( key == KEY_END ) return 1 ;
+	return 0 ;		// no, this is not a superblock key
+}
+
+void hexdump(unsigned char *buffer, int n)
+{
+	for( int row = 0 ; row <= n/8 ; row++ )
+	{
+		for( int col = 0 ; col < 8 ; col++ )
+		{
+			int offset = row*8+col ;
+			if( offset < n )
+			{
+				printf("%02x ",buffer[offset]) ;
+			}
+			else
+			{
+				printf("   ") ;
+			}
+		}
+		printf("\t") ;
+		for( int col = 0 ; col < 8 ; col++ )
+		{
+			int offset = row*8+col ;
+			if( offset < n )
+			{
+				if( isprint(buffer[offset]) )
+					printf("%c",buffer[offset]) ;
+				else
+					printf(".") ;
+			}
+			else
+			{
+				printf("   ") ;
+			}
+		}
+		printf("\n") ;
+	}
+}
+
+char *strkey_r(fourcc name, char *buffer)	// writes the four characters of a key into buffer, which holds SIZE_KEY bytes, and returns it
+{
+	int size = sizeof(name) ;
+	memcpy(buffer,(void *)&name,size) ;
+	endian_fixup(buffer,size) ;
+	buffer[size] = '\0' ;
+	return buffer ;
+}
+
+int fixup_sizes(struct node *list)
+{
+	uint32_t head_size = calculate_head_size(list) ;
+	if( head_size == 0 ) return 1 ;
+	uint32_t body_size = calculate_body_size(list) ;
+	if( body_size == 0 ) return 1 ;
+	uint32_t aqlv_size = head_size + sizeof(struct block_header) + body_size + sizeof(struct block_header) ;
+	if( set_block_size(list,KEY_AQLV,aqlv_size) ) return 1 ;
+	if( set_block_size(list,KEY_HEAD,head_size) ) return 1 ;
+	if( set_block_size(list,KEY_BODY,body_size) ) return 1 ;
+	return 0 ;
+}
+
+uint32_t calculate_body_size(struct node *list)			// returns the size of the blocks in the BODY superblock
+{
+	int in_body = 0 ;
+	uint32_t size = 0 ;
+	while( list != NULL )
+	{
+		if( list->key == KEY_END )
+			in_body = 0 ;
+		if( in_body )
+			size += ( list->size + sizeof(struct block_header) ) ;	// remember to count the block header
+		if( list->key == KEY_BODY )
+			in_body = 1 ;
+		list = list->next ;
+	} ;
+	return size ;
+}
+
+uint32_t calculate_head_size(struct node *list)			// returns the size of the blocks in the HEAD superblock
+{
+	int in_head = 0 ;
+	uint32_t size = 0 ;
+	while( list != NULL )
+	{
+		if( list->key == KEY_END )
+			in_head = 0 ;
+		if( list->key == KEY_BODY )
+			in_head = 0 ;
+		if( in_head )
+			size += (list->size + sizeof(struct block_header) ) ;	// remember to count the block header
+		if( list->key == KEY_HEAD )
+			in_head = 1 ;
+		list = list->next ;
+	} ;
+	return size ;
+}
+
+int set_block_size(struct node *list, fourcc key, uint32_t size)	// returns 1 for failure, 0 for success
+{
+	while( list != NULL )
+	{
+		if( list->key == key )
+		{
+			list->size = size ;
+			return 0 ;
+		}
+		list = list->next ;
+	}
+	return 1 ;
+}
+
+void show_list(struct node *list)
+{
+	unsigned int count = 0 ;
+	while( list != NULL )
+	{
+		printf("Node %u: key %.4s size %u\n",count,(char *)&(list->key),list->size) ;
+		list = list->next ;
+		count++ ;
+	}
+}
+
+int dump_list(struct node *list, FILE *outfile, struct dump_options *options) // goes through the list of nodes, writing an ascii text description of each node to outfile
+{
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	config.compact = options->compact ;
+	while( list != NULL )
+	{
+		//printf("debug: dump_list: node has key '%s'\n",strkey(list->key)) ;
+		if( options->just_header && list->key == KEY_BODY ) return 0 ;
+		if( dump_node(list,&config,outfile) )
+			return 1 ;
+		list = list->next ;
+	}
+	return 0 ;
+}
+
+#define DUMP_WINDOW	4		// items formatted ahead of the writer, per thread
+
+int dump_parallel(struct node *list, FILE *outfile, struct dump_options *options)	// formats sweep sets on worker threads, this thread writes them out in order
+{
+	struct dump_pool pool ;
+	memset(&pool,0,sizeof(struct dump_pool)) ;
+	pool.window = DUMP_WINDOW*options->threads ;
+	pool.items = calloc(pool.window,sizeof(struct dump_item)) ;
+	if( pool.items == NULL )
+		return dump_list(list,outfile,options) ;
+	pool.count = SIZE_MAX ;
+	pool.cursor = list ;
+	pool.config.compact = options->compact ;
+	pthread_mutex_init(&pool.lock,NULL) ;
+	pthread_cond_init(&pool.ready,NULL) ;
+	pthread_cond_init(&pool.space,NULL) ;
+	pthread_t threads[MAX_THREADS] ;
+	int nthreads = 0 ;
+	while( nthreads < options->threads && pthread_create(&threads[nthreads],NULL,dump_worker,&pool) == 0 )
+		nthreads++ ;
+	int err = ( nthreads == 0 ) ;
+	if( err )
+		printf("Cannot start tsdump threads\n") ;
+	pthread_mutex_lock(&pool.lock) ;
+	for( size_t sequence = 0 ; !err ; sequence++ )
+	{
+		struct dump_item *item = &(pool.items[sequence % pool.window]) ;
+		while( sequence < pool.count && !(item->done && item->sequence == sequence) )
+			pthread_cond_wait(&pool.ready,&pool.lock) ;
+		if( sequence >= pool.count )
+			break ;
+		pthread_mutex_unlock(&pool.lock) ;		// write without holding up the workers
+		err = item->err || fwrite(item->text,1,item->length,outfile) != item->length ;
+		free(item->text) ;
+		pthread_mutex_lock(&pool.lock) ;
+		item->text = NULL ;
+		item->done = 0 ;
+		pool.written++ ;
+		pthread_cond_broadcast(&pool.space) ;
+	}
+	pool.stop = 1 ;
+	pthread_cond_broadcast(&pool.space) ;
+	pthread_mutex_unlock(&pool.lock) ;
+	for( int loop = 0 ; loop < nthreads ; loop++ )
+		pthread_join(threads[loop],NULL) ;
+	for( size_t loop = 0 ; loop < pool.window ; loop++ )	// items left over after an error
+		free(pool.items[loop].text) ;
+	free(pool.items) ;
+	pthread_cond_destroy(&pool.space) ;
+	pthread_cond_destroy(&pool.ready) ;
+	pthread_mutex_destroy(&pool.lock) ;
+	return err ;
+}
+
+void *dump_worker(void *argument)	// takes the next sweep set from the pool and formats it into memory, until the list runs out
+{
+	struct dump_pool *pool = argument ;
+	pthread_mutex_lock(&pool->lock) ;
+	for( ;; )
+	{
+		while( !pool->stop && pool->cursor != NULL && pool->next >= pool->written + pool->window )
+			pthread_cond_wait(&pool->space,&pool->lock) ;
+		if( pool->stop || pool->cursor == NULL )
+			break ;
+		struct dump_item *item = &(pool->items[pool->next % pool->window]) ;
+		item->sequence = pool->next++ ;
+		item->first = pool->cursor ;
+		item->config = pool->config ;
+		struct node *node = pool->cursor ;		// hand out up to the first block after a run of alvl blocks
+		int previous_alvl = 0 ;
+		for( ; node != NULL && !(previous_alvl && node->key != KEY_alvl) ; node = node->next )
+		{
+			previous_alvl = ( node->key == KEY_alvl ) ;
+			track_config(node,&(pool->config)) ;
+		}
+		item->end = node ;
+		pool->cursor = node ;
+		if( node == NULL )
+			pool->count = pool->next ;
+		pthread_mutex_unlock(&pool->lock) ;
+		FILE *text = open_memstream(&(item->text),&(item->length)) ;
+		int err = ( text == NULL ) ;
+		for( node = item->first ; !err && node != item->end ; node = node->next )
+			err = dump_node(node,&(item->config),text) ;
+		if( text != NULL && fclose(text) != 0 )
+			err = 1 ;
+		pthread_mutex_lock(&pool->lock) ;
+		item->err = err ;
+		item->done = 1 ;
+		pthread_cond_broadcast(&pool->ready) ;
+	}
+	pthread_cond_broadcast(&pool->ready) ;		// the writer may be waiting for the count
+	pthread_mutex_unlock(&pool->lock) ;
+	return NULL ;
+}
+
+void track_config(struct node *node, struct config *config)	// updates config the way dumping node would, without formatting it
+{
+	if( node->key == KEY_fbin && node->size >= sizeof(fourcc)*2 )
+		memcpy(&(config->bin_type),node->data+sizeof(fourcc),sizeof(fourcc)) ;
+	if( node->key == KEY_scal && node->size >= sizeof(double)*2 )
+	{
+		memcpy(&(config->scalar_one),node->data,sizeof(double)) ;
+		memcpy(&(config->scalar_two),node->data+sizeof(double),sizeof(double)) ;
+	}
+}
+
+int dump_node(struct node *node, struct config *config, FILE *outfile)	// writes an ascii text description of one node to outfile
+{
+	struct block_functions *block_functions = find_block_functions(node->key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
+	if( block_functions == NULL )
+	{
+		printf("Cannot dump block '%s'\n",strkey(node->key)) ;
+		return 1 ;
+	}
+	int (*dump_function)(struct node *, struct config *, FILE *) = block_functions->dump ;
+	int err = (*dump_function)(node,config,outfile) ;	// calls a function from the Global_function_dictionary corresponding to the block key
+	if( err )
+	{
+		printf("Error dumping block '%s'\n",strkey(node->key)) ;
+		return 1 ;
+	}
+	return 0 ;
+}
+
+int fixup_data_aqlv(struct node *node, struct config *config)
+{
+	return 0 ;
+}
+
+int dump_block_aqlv(struct node *node, struct config *config, FILE *outfile)
+{
+	fprintf(outfile,"%s\n",strkey(KEY_AQLV)) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_aqlv(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for AQLV block, reader not used
+{
+	struct node *newnode = new_node(context,list,KEY_AQLV) ;
+	if( newnode == NULL ) return 1 ;
+	// fixup size at the very end
+	// no explicit data block, it's composed of sub blocks
+	return 0 ;
+}
+
+int gen_block_aqlv(struct node *node, struct config *config, FILE *outfile)
+{
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	return 0 ;
+}
+
+int fixup_data_head(struct node *node, struct config *config)
+{
+	return 0 ;
+}
+
+int dump_block_head(struct node *node, struct config *config, FILE *outfile)
+{
+	fprintf(outfile,"%s\n",strkey(KEY_HEAD)) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_head(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)
+{
+	struct node *newnode = new_node(context,list,KEY_HEAD) ;
+	if( newnode == NULL ) return 1 ;
+	// fixup size at the very end
+	// no explicit data block, it's composed of sub blocks
+	return 0 ;
+}
+
+int gen_block_head(struct node *node, struct config *config, FILE *outfile)
+{
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_sign				// contains only the data portion for this type of block, i.e. no header data (key, size)
+{
+	fourcc version ;			// file version
+	fourcc filetype ;			// file type
+	fourcc sitecode ; 			// site code
+	uint32_t userflags ;			// user flags
+	char description[SIZE_DESCRIPTION] ;	// file description
+	char ownername[SIZE_OWNERNAME] ;	// owner name
+	char comment[SIZE_COMMENT] ;		// comment
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_sign(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_sign) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_sign)) ;
+		return 1 ;
+	}
+	struct block_sign *sign = (struct block_sign *)(node->data) ;
+	endian_fixup(&(sign->version),sizeof(sign->version)) ;
+	endian_fixup(&(sign->filetype),sizeof(sign->filetype)) ;
+	endian_fixup(&(sign->sitecode),sizeof(sign->sitecode)) ;
+	endian_fixup(&(sign->userflags),sizeof(sign->userflags)) ;
+	return 0 ;
+}
+
+int dump_block_sign(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_sign) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_sign)) ;
+		return 1 ;
+	}
+	struct block_sign *sign = (struct block_sign *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_sign)) ;
+	fprintf(outfile,"version:%s\n",strkey(sign->version)) ;
+	fprintf(outfile,"filetype:%s\n",strkey(sign->filetype)) ;
+	fprintf(outfile,"sitecode:%s\n",strkey(sign->sitecode)) ;
+	fprintf(outfile,"userflags:%x\n",sign->userflags) ;
+	fprintf(outfile,"description:%.*s\n",SIZE_DESCRIPTION,sign->description) ;
+	fprintf(outfile,"ownername:%.*s\n",SIZE_OWNERNAME,sign->ownername) ;
+	fprintf(outfile,"comment:%.*s\n",SIZE_OWNERNAME,sign->comment) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_sign(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)
+{
+	struct node *newnode = new_node(context,list,KEY_sign) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_sign *sign = new_data(context,newnode,sizeof(struct block_sign)) ;
+	if( sign == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"version:%4c",(void *)&(sign->version)) ) return 1 ;
+	endian_fixup(&(sign->version),sizeof(sign->version)) ;		// read as 4 characters, held in host order like a parsed block
+	if( read_parameter(reader,"filetype:%4c",(void *)&(sign->filetype)) ) return 1 ;
+	endian_fixup(&(sign->filetype),sizeof(sign->filetype)) ;
+	if( read_parameter(reader,"sitecode:%4c",(void *)&(sign->sitecode)) ) return 1 ;
+	endian_fixup(&(sign->sitecode),sizeof(sign->sitecode)) ;
+	if( read_parameter(reader,"userflags:%x",(void *)&(sign->userflags)) ) return 1 ;
+	char format[32] ;
+	sprintf(format,"description:%%%dc",SIZE_DESCRIPTION) ;
+	if( read_parameter(reader,format,(void *)(sign->description)) ) return 1 ;
+	sprintf(format,"ownername:%%%dc",SIZE_OWNERNAME) ;
+	if( read_parameter(reader,format,(void *)(sign->ownername)) ) return 1 ;
+	sprintf(format,"comment:%%%dc",SIZE_COMMENT) ;
+	if( read_parameter(reader,format,(void *)(sign->comment)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_sign(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_sign copy = *(struct block_sign *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_sign *sign = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(sign->version),sizeof(sign->version)) ;
+	if( fwrite(&(sign->version),sizeof(sign->version),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(sign->filetype),sizeof(sign->filetype)) ;
+	if( fwrite(&(sign->filetype),sizeof(sign->filetype),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(sign->sitecode),sizeof(sign->sitecode)) ;
+	if( fwrite(&(sign->sitecode),sizeof(sign->sitecode),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(sign->userflags),sizeof(sign->userflags)) ;
+	if( fwrite(&(sign->userflags),sizeof(sign->userflags),1,outfile) != 1 ) return 1 ;
+	if( fwrite(&(sign->description),SIZE_DESCRIPTION,1,outfile) != 1 ) return 1 ;
+	if( fwrite(&(sign->ownername),SIZE_OWNERNAME,1,outfile) != 1 ) return 1 ;
+	if( fwrite(&(sign->comment),SIZE_COMMENT,1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_mcda
+{
+	uint32_t timestamp ;		// mac timestamp of first sweep
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_mcda(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_mcda) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_mcda)) ;
+		return 1 ;
+	}
+	struct block_mcda *mcda = (struct block_mcda *)(node->data) ;
+	endian_fixup(&(mcda->timestamp),sizeof(mcda->timestamp)) ;
+	return 0 ;
+}
+
+int dump_block_mcda(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_mcda) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_mcda)) ;
+		return 1 ;
+	}
+	struct block_mcda *mcda = (struct block_mcda *)(node->data) ;
+	uint32_t mcda_time = mcda->timestamp ;
+	time_t t = mcda_time ;
+	fprintf(outfile,"%s\n",strkey(KEY_mcda)) ;
+	if( t != 0 )
+	{
+		t -= 2082844800 ;	// move epoc from 1904-01-01 00:00:00 to 1970-01-01 00:00:00 
+		fprintf(outfile,"timestamp:%lu (NB: seconds since 1970) (%.24s)\n",t,ctime(&t)) ;
+	}
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_mcda(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for mcda block
+{
+	struct node *newnode = new_node(context,list,KEY_mcda) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_mcda *mcda = new_data(context,newnode,sizeof(struct block_mcda)) ;
+	if( mcda == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"timestamp:%u",(void *)&(mcda->timestamp)) ) return 1 ;
+	mcda->timestamp += 2082844800 ;	// move epoc from 1970-01-01 00:00:00 to 1904-01-01 00:00:00 
+	return 0 ;
+}
+
+int gen_block_mcda(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_mcda copy = *(struct block_mcda *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_mcda *mcda = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(mcda->timestamp),sizeof(mcda->timestamp)) ;
+	if( fwrite(&(mcda->timestamp),sizeof(mcda->timestamp),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_cnst
+{
+	int32_t nchannels ;		// number of antennas/channels (normally 3)
+	int32_t nsweeps ;		// number of sweeps (normally 32)
+	int32_t nsamples ;		// number of samples (normally 2048)
+	int32_t iqindicator ;		// iqindicator: 1=?, 2=IQ
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_cnst(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_cnst) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_cnst)) ;
+		return 1 ;
+	}
+	struct block_cnst *cnst = (struct block_cnst *)node->data ;
+	endian_fixup(&(cnst->nchannels),sizeof(cnst->nchannels)) ;
+	endian_fixup(&(cnst->nsweeps),sizeof(cnst->nchannels)) ;
+	endian_fixup(&(cnst->nsamples),sizeof(cnst->nsamples)) ;
+	endian_fixup(&(cnst->iqindicator),sizeof(cnst->iqindicator)) ;
+	return 0 ;
+}
+
+int dump_block_cnst(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_cnst) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_cnst)) ;
+		return 1 ;
+	}
+	struct block_cnst *cnst = (struct block_cnst *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_cnst)) ;
+	fprintf(outfile,"nchannels:%d\n",cnst->nchannels) ;
+	fprintf(outfile,"nsweeps:%d\n",cnst->nsweeps) ;
+	fprintf(outfile,"nsamples:%d\n",cnst->nsamples) ;
+	fprintf(outfile,"iqindicator:%d\n",cnst->iqindicator) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_cnst(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for cnst block
+{
+	struct node *newnode = new_node(context,list,KEY_cnst) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_cnst *cnst = new_data(context,newnode,sizeof(struct block_cnst)) ;
+	if( cnst == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"nchannels:%d",(void *)&(cnst->nchannels)) ) return 1 ;
+	if( read_parameter(reader,"nsweeps:%d",(void *)&(cnst->nsweeps)) ) return 1 ;
+	if( read_parameter(reader,"nsamples:%d",(void *)&(cnst->nsamples)) ) return 1 ;
+	if( read_parameter(reader,"iqindicator:%d",(void *)&(cnst->iqindicator)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_cnst(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_cnst copy = *(struct block_cnst *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_cnst *cnst = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(cnst->nchannels),sizeof(cnst->nchannels)) ;
+	if( fwrite(&(cnst->nchannels),sizeof(cnst->nchannels),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(cnst->nsweeps),sizeof(cnst->nsweeps)) ;
+	if( fwrite(&(cnst->nsweeps),sizeof(cnst->nsweeps),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(cnst->nsamples),sizeof(cnst->nsamples)) ;
+	if( fwrite(&(cnst->nsamples),sizeof(cnst->nsamples),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(cnst->iqindicator),sizeof(cnst->iqindicator)) ;
+	if( fwrite(&(cnst->iqindicator),sizeof(cnst->iqindicator),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_swep
+{
+	int32_t samplespersweep ;	// number of samples per sweep/channels (normally 2048)
+	double sweepstart ;		// sweep start frequency in Hertz
+	double sweepbandwidth ;		// sweep bandwidth in Hertz
+	double sweeprate ;		// sweep rate in Hertz
+	int32_t rangeoffset ;		// rangeoffset (not used)
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_swep(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_swep) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_swep)) ;
+		return 1 ;
+	}
+	struct block_swep *swep = (struct block_swep *)(node->data) ;
+	endian_fixup(&(swep->samplespersweep),sizeof(swep->samplespersweep)) ;
+	endian_fixup(&(swep->sweepstart),sizeof(swep->sweepstart)) ;
+	endian_fixup(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth)) ;
+	endian_fixup(&(swep->sweeprate),sizeof(swep->sweeprate)) ;
+	endian_fixup(&(swep->rangeoffset),sizeof(swep->rangeoffset)) ;
+	return 0 ;
+}
+
+int dump_block_swep(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_swep) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_swep)) ;
+		return 1 ;
+	}
+	struct block_swep *swep = (struct block_swep *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_swep)) ;
+	fprintf(outfile,"samplespersweep:%d\n",swep->samplespersweep) ;
+	fprintf(outfile,"sweepstart:%.20lf\n",swep->sweepstart) ;
+	fprintf(outfile,"sweepbandwidth:%.20lf\n",swep->sweepbandwidth) ;
+	fprintf(outfile,"sweeprate:%.20lf\n",swep->sweeprate) ;
+	fprintf(outfile,"rangeoffset:%d\n",swep->rangeoffset) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_swep(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for swep block
+{
+	struct node *newnode = new_node(context,list,KEY_swep) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_swep *swep = new_data(context,newnode,sizeof(struct block_swep)) ;
+	if( swep == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"samplespersweep:%d",(void *)&(swep->samplespersweep)) ) return 1 ;
+	if( read_parameter(reader,"sweepstart:%lf",(void *)&(swep->sweepstart)) ) return 1 ;
+	if( read_parameter(reader,"sweepbandwidth:%lf",(void *)&(swep->sweepbandwidth)) ) return 1 ;
+	if( read_parameter(reader,"sweeprate:%lf",(void *)&(swep->sweeprate)) ) return 1 ;
+	if( read_parameter(reader,"rangeoffset:%d",(void *)&(swep->rangeoffset)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_swep(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_swep copy = *(struct block_swep *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_swep *swep = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(swep->samplespersweep),sizeof(swep->samplespersweep)) ;
+	if( fwrite(&(swep->samplespersweep),sizeof(swep->samplespersweep),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(swep->sweepstart),sizeof(swep->sweepstart)) ;
+	if( fwrite(&(swep->sweepstart),sizeof(swep->sweepstart),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth)) ;
+	if( fwrite(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(swep->sweeprate),sizeof(swep->sweeprate)) ;
+	if( fwrite(&(swep->sweeprate),sizeof(swep->sweeprate),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(swep->rangeoffset),sizeof(swep->rangeoffset)) ;
+	if( fwrite(&(swep->rangeoffset),sizeof(swep->rangeoffset),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_fbin
+{
+	fourcc bin_format ;	// format (normally 'cviq')
+	fourcc bin_type ;	// type of ALVL data ('flt4','fix4','fix3','fix2')
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_fbin(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_fbin) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_fbin)) ;
+		return 1 ;
+	}
+	struct block_fbin *fbin = (struct block_fbin *)node->data ;
+	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;
+	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;
+	return 0 ;
+}
+
+int dump_block_fbin(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_fbin) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_fbin)) ;
+		return 1 ;
+	}
+	struct block_fbin *fbin = (struct block_fbin *)(node->data) ;
+	config->bin_type = fbin->bin_type ;	// remember this for alvl blocks
+	fprintf(outfile,"%s\n",strkey(KEY_fbin)) ;
+	fprintf(outfile,"format:%s\n",strkey(fbin->bin_format)) ;
+	fprintf(outfile,"type:%s\n",strkey(fbin->bin_type)) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_fbin(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for fbin block
+{
+	struct node *newnode = new_node(context,list,KEY_fbin) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_fbin *fbin = new_data(context,newnode,sizeof(struct block_fbin)) ;
+	if( fbin == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	char format[16] ;
+	sprintf(format,"format:%%%lus",sizeof(fbin->bin_format)) ;
+	if( read_parameter(reader,format,(void *)&(fbin->bin_format)) ) return 1 ;	// read as a 4 byte string
+	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;		// then endian correct to 4 bytes int
+	sprintf(format,"type:%%%lus",sizeof(fbin->bin_type)) ;
+	if( read_parameter(reader,format,(void *)&(fbin->bin_type)) ) return 1 ;	// read as a 4 byte string
+	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;		// then endian correct to 4 bytes int
+	config->bin_type = fbin->bin_type ;	// remember this for alvl blocks
+	//printf("debug: make_node_fbin: fbin->bin_type=%s\n",strkey(fbin->bin_type)) ;
+	return 0 ;
+}
+
+int gen_block_fbin(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_fbin copy = *(struct block_fbin *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_fbin *fbin = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;
+	if( fwrite(&(fbin->bin_format),sizeof(fbin->bin_format),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;
+	if( fwrite(&(fbin->bin_type),sizeof(fbin->bin_type),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+int fixup_data_body(struct node *node, struct config *config)
+{
+	return 0 ;
+}
+
+int dump_block_body(struct node *node, struct config *config, FILE *outfile)
+{
+	fprintf(outfile,"%s\n",strkey(KEY_BODY)) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_body(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for body block
+{
+	struct node *newnode = new_node(context,list,KEY_BODY) ;
+	if( newnode == NULL ) return 1 ;
+	// fixup size at the very end
+	// no explicit data block, it's composed of sub blocks
+	return 0 ;
+}
+
+int gen_block_body(struct node *node, struct config *config, FILE *outfile)
+{
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_gtag
+{
+	uint32_t gtag ;		// unknown
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_gtag(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_gtag) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_gtag)) ;
+		return 1 ;
+	}
+	struct block_gtag *gtag = (struct block_gtag *)node->data ;
+	endian_fixup(&(gtag->gtag),sizeof(gtag->gtag)) ;			// fixup the endian order
+	return 0 ;
+}
+
+int dump_block_gtag(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_gtag) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_gtag)) ;
+		return 1 ;
+	}
+	struct block_gtag *gtag = (struct block_gtag *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_gtag)) ;
+	fprintf(outfile,"gtag:%u\n",gtag->gtag) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_gtag(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for gtag block
+{
+	struct node *newnode = new_node(context,list,KEY_gtag) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_gtag *gtag = new_data(context,newnode,sizeof(struct block_gtag)) ;
+	if( gtag == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"gtag:%u",(void *)&(gtag->gtag)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_gtag(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_gtag copy = *(struct block_gtag *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_gtag *gtag = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(gtag->gtag),sizeof(gtag->gtag)) ;
+	if( fwrite(&(gtag->gtag),sizeof(gtag->gtag),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+struct block_atag
+{
+	uint32_t atag ;		// unknown
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_atag(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_atag) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_atag)) ;
+		return 1 ;
+	}
+	struct block_atag *atag = (struct block_atag *)node->data ;
+	endian_fixup(&(atag->atag),sizeof(atag->atag)) ;			// fixup the endian order
+	return 0 ;
+}
+
+int dump_block_atag(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_atag) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_atag)) ;
+		return 1 ;
+	}
+	struct block_atag *atag = (struct block_atag *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_atag)) ;
+	fprintf(outfile,"atag:%u\n",atag->atag) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_atag(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for atag block
+{
+	struct node *newnode = new_node(context,list,KEY_atag) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_atag *atag = new_data(context,newnode,sizeof(struct block_atag)) ;
+	if( atag == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"atag:%u",(void *)&(atag->atag)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_atag(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_atag copy = *(struct block_atag *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_atag *atag = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(atag->atag),sizeof(atag->atag)) ;
+	if( fwrite(&(atag->atag),sizeof(atag->atag),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_indx
+{
+	uint32_t index ;		// index
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_indx(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_indx) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_indx)) ;
+		return 1 ;
+	}
+	struct block_indx *indx = (struct block_indx *)node->data ;
+	endian_fixup(&(indx->index),sizeof(indx->index)) ;			// fixup the endian order
+	return 0 ;
+}
+
+int dump_block_indx(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_indx) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_indx)) ;
+		return 1 ;
+	}
+	struct block_indx *indx = (struct block_indx *)(node->data) ;
+	fprintf(outfile,"%s\n",strkey(KEY_indx)) ;
+	fprintf(outfile,"index:%u\n",indx->index) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_indx(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for indx block
+{
+	struct node *newnode = new_node(context,list,KEY_indx) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_indx *indx = new_data(context,newnode,sizeof(struct block_indx)) ;
+	if( indx == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"index:%u",(void *)&(indx->index)) ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_indx(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_indx copy = *(struct block_indx *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_indx *indx = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(indx->index),sizeof(indx->index)) ;
+	if( fwrite(&(indx->index),sizeof(indx->index),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct block_scal
+{
+	double scalar_one ;		// scaling value for I samples
+	double scalar_two ;		// scaling value for Q samples
+} __attribute__((packed)) ;	// make sure there's no padding
+
+int fixup_data_scal(struct node *node, struct config *config)
+{
+	if( node->size < sizeof(struct block_scal) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_scal)) ;
+		return 1 ;
+	}
+	struct block_scal *scal = (struct block_scal *)node->data ;
+	endian_fixup(&(scal->scalar_one),sizeof(scal->scalar_one)) ;
+	endian_fixup(&(scal->scalar_two),sizeof(scal->scalar_two)) ;
+	return 0 ;
+}
+
+int dump_block_scal(struct node *node, struct config *config, FILE *outfile)
+{
+	if( node->size < sizeof(struct block_scal) )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_scal)) ;
+		return 1 ;
+	}
+	struct block_scal *scal = (struct block_scal *)(node->data) ;
+	config->scalar_one = scal->scalar_one ;	// remember this for alvl blocks
+	config->scalar_two = scal->scalar_two ;	// remember this for alvl blocks
+	fprintf(outfile,"%s\n",strkey(KEY_scal)) ;
+	fprintf(outfile,"scalar_one:%.20lf\n",scal->scalar_one) ;
+	fprintf(outfile,"scalar_two:%.20lf\n",scal->scalar_two) ;
+	fprintf(outfile,"\n") ;
+	return 0 ;
+}
+
+int make_node_scal(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for scal block
+{
+	struct node *newnode = new_node(context,list,KEY_scal) ;
+	if( newnode == NULL ) return 1 ;
+	struct block_scal *scal = new_data(context,newnode,sizeof(struct block_scal)) ;
+	if( scal == NULL ) return 1 ;
+	if( read_block(reader) ) return 1 ;
+	if( read_parameter(reader,"scalar_one:%lf",(void *)&(scal->scalar_one)) ) return 1 ;
+	if( read_parameter(reader,"scalar_two:%lf",(void *)&(scal->scalar_two)) ) return 1 ;
+	config->scalar_one = scal->scalar_one ;	// remember this for alvl blocks
+	config->scalar_two = scal->scalar_two ;	// remember this for alvl blocks
+	return 0 ;
+}
+
+int gen_block_scal(struct node *node, struct config *config, FILE *outfile)
+{
+	struct block_scal copy = *(struct block_scal *)(node->data) ;	// swap a copy, the node stays in host order
+	struct block_scal *scal = &copy ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	endian_fixup(&(scal->scalar_one),sizeof(scal->scalar_one)) ;
+	if( fwrite(&(scal->scalar_one),sizeof(scal->scalar_one),1,outfile) != 1 ) return 1 ;
+	endian_fixup(&(scal->scalar_two),sizeof(scal->scalar_two)) ;
+	if( fwrite(&(scal->scalar_two),sizeof(scal->scalar_two),1,outfile) != 1 ) return 1 ;
+	return 0 ;
+}
+
+
+struct sample_codec Global_sample_codecs[] =		// the alvl sample types an fbin block can name, the values are big endian in the file
+{
+	{ BINTYPE_FIX2, 2, 0, (double )0x7FFF, 32768.0, "i2", load_fix2, store_fix2, store_counts_fix2 },
+	{ BINTYPE_FIX3, 3, 0, (double )0x7FFFFF, 8388608.0, "i4", load_fix3, store_fix3, store_counts_fix3 },	// held as 3 bytes, widened to 32 bits when exported
+	{ BINTYPE_FIX4, 4, 0, (double )0x7FFFFFFF, 2147483648.0, "i4", load_fix4, store_fix4, store_counts_fix4 },
+	{ BINTYPE_FLT4, 4, 1, (double )1, 1.0, "f4", load_flt4, store_flt4, NULL },
+	{ 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL }
+} ;
+
+struct sample_codec *find_sample_codec(fourcc bin_type)	// the codec of a bin_type, fix2 if there is no fbin block (0), NULL if it is unknown
+{
+	if( bin_type == 0 )
+		bin_type = BINTYPE_FIX2 ;			// what the files normally have
+	for( struct sample_codec *codec = Global_sample_codecs ; codec->bin_type != 0 ; codec++ )
+		if( codec->bin_type == bin_type )
+			return codec ;
+	return NULL ;
+}
+
+struct sample_codec *sample_layout(fourcc bin_type)	// the codec alvl blocks are swapped and counted with, an unknown bin_type is kept as 16 bit values and refused once the samples are used
+{
+	struct sample_codec *codec = find_sample_codec(bin_type) ;
+	return ( codec != NULL ) ? codec : Global_sample_codecs ;
+}
+
+void swap_samples(struct sample_codec *codec, void *data, size_t count)	// swaps count I or Q values between file and host order
+{
+	if( !HOST_LITTLE_ENDIAN )
+		return ;
+	switch( codec->width )
+	{
+		case 2: (*swap_kernel()->swap16)(data,count) ; break ;
+		case 3: (*swap_kernel()->swap24)(data,count) ; break ;
+		case 4: (*swap_kernel()->swap32)(data,count) ; break ;
+	}
+}
+
+int32_t get_fix3(const unsigned char *p)	// a 24 bit value in host order, sign extended
+{
+	uint32_t value = HOST_LITTLE_ENDIAN ? (p[0] | p[1] << 8 | (uint32_t )p[2] << 16) : ((uint32_t )p[0] << 16 | p[1] << 8 | p[2]) ;
+	return (int32_t )(value << 8) >> 8 ;
+}
+
+void put_fix3(int32_t value, unsigned char *p)	// the low 24 bits of value in host order
+{
+	p[HOST_LITTLE_ENDIAN ? 0 : 2] = value ;
+	p[1] = value >> 8 ;
+	p[HOST_LITTLE_ENDIAN ? 2 : 0] = value >> 16 ;
+}
+
+// one load and one store per sample width, simple enough loops for the compiler to vectorize; the data need not be aligned
+
+void load_fix2(const unsigned char *data, size_t count, double *values)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		int16_t value ;
+		memcpy(&value,data+loop*sizeof(value),sizeof(value)) ;
+		values[loop] = value ;
+	}
+}
+
+void load_fix3(const unsigned char *data, size_t count, double *values)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+		values[loop] = get_fix3(data+loop*3) ;
+}
+
+void load_fix4(const unsigned char *data, size_t count, double *values)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		int32_t value ;
+		memcpy(&value,data+loop*sizeof(value),sizeof(value)) ;
+		values[loop] = value ;
+	}
+}
+
+void load_flt4(const unsigned char *data, size_t count, double *values)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		float value ;
+		memcpy(&value,data+loop*sizeof(value),sizeof(value)) ;
+		values[loop] = value ;
+	}
+}
+
+void store_fix2(const double *values, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		int16_t value = values[loop] ;
+		memcpy(data+loop*sizeof(value),&value,sizeof(value)) ;
+	}
+}
+
+void store_fix3(const double *values, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+		put_fix3(values[loop],data+loop*3) ;
+}
+
+void store_fix4(const double *values, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		int32_t value = values[loop] ;
+		memcpy(data+loop*sizeof(value),&value,sizeof(value)) ;
+	}
+}
+
+void store_flt4(const double *values, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		float value = values[loop] ;
+		memcpy(data+loop*sizeof(value),&value,sizeof(value)) ;
+	}
+}
+
+void store_counts_fix2(const int32_t *counts, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+	{
+		int16_t value = counts[loop] ;
+		memcpy(data+loop*sizeof(value),&value,sizeof(value)) ;
+	}
+}
+
+void store_counts_fix3(const int32_t *counts, size_t count, unsigned char *data)
+{
+	for( size_t loop = 0 ; loop < count ; loop++ )
+		put_fix3(counts[loop],data+loop*3) ;
+}
+
+void store_counts_fix4(const int32_t *counts, size_t count, unsigned char *data)
+{
+	memcpy(data,counts,count*sizeof(int32_t)) ;
+}
+
+int fixup_data_alvl(struct node *node, struct config *config)
+{
+	struct sample_codec *codec = sample_layout(config->bin_type) ;
+	size_t pair = 2*codec->width ;			// bytes of one I/Q pair
+	if( node->size < pair )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_alvl)) ;
+		return 1 ;
+	}
+	swap_samples(codec,node->data,2*(node->size/pair)) ;	// I and Q have the same type, swap the whole block in one call
+	return 0 ;
+}
+
+int dump_block_alvl(struct node *node, struct config *config, FILE *outfile)
+{
+	struct sample_codec *codec = find_sample_codec(config->bin_type) ;
+	if( codec == NULL )
+	{
+		printf("Unknown bin_type '%s' (%x) at index %d\n",strkey(config->bin_type),config->bin_type,config->index) ;
+		return 1;
+	}
+	size_t pair = 2*codec->width ;
+	if( node->size < pair )
+	{
+		printf("Block '%s' is truncated\n",strkey(KEY_alvl)) ;
+		return 1 ;
+	}
+	fprintf(outfile,"%s\n",strkey(KEY_alvl)) ;
+	if( config->compact )
+		return dump_alvl_counts(node,codec,outfile) ;
+	size_t nsamples = (node->size)/pair ;
+	double values[2*SIZE_LOAD_CHUNK] ;		// the counts of a run of samples
+	char text[SIZE_TEXT_BUFFER] ;			// format many lines, then write them with one call
+	size_t used = 0 ;
+	for( size_t loop = 0 ; loop < nsamples ; loop++ )
+	{
+		if( loop % SIZE_LOAD_CHUNK == 0 )
+			(*codec->load)(node->data+loop*pair,2*( nsamples-loop < SIZE_LOAD_CHUNK ? nsamples-loop : SIZE_LOAD_CHUNK ),values) ;
+		if( used > SIZE_TEXT_BUFFER - 2*(SIZE_NUMBER+3) )
+		{
+			if( fwrite(text,1,used,outfile) != used ) return 1 ;
+			used = 0 ;
+		}
+		double *value = values + 2*(loop % SIZE_LOAD_CHUNK) ;
+		double scaled_i = value[0]/codec->factor*config->scalar_one ;	// precedence order?
+		double scaled_q = value[1]/codec->factor*config->scalar_two ;
+		text[used++] = 'i' ;
+		text[used++] = ':' ;
+		used += format_double(scaled_i,text+used) ;
+		text[used++] = '\n' ;
+		text[used++] = 'q' ;
+		text[used++] = ':' ;
+		used += format_double(scaled_q,text+used) ;
+		text[used++] = '\n' ;
+	}
+	text[used++] = '\n' ;
+	if( fwrite(text,1,used,outfile) != used ) return 1 ;
+	return 0 ;
+}
+
+int dump_alvl_counts(struct node *node, struct sample_codec *codec, FILE *outfile)	// writes the raw I/Q counts, COUNTS_PER_LINE pairs to an "iq:" line
+{
+	size_t pair = 2*codec->width ;
+	size_t nsamples = (node->size)/pair ;
+	double values[2*SIZE_LOAD_CHUNK] ;
+	char text[SIZE_TEXT_BUFFER] ;
+	size_t used = 0 ;
+	for( size_t loop = 0 ; loop < nsamples ; loop++ )
+	{
+		if( loop % SIZE_LOAD_CHUNK == 0 )
+			(*codec->load)(node->data+loop*pair,2*( nsamples-loop < SIZE_LOAD_CHUNK ? nsamples-loop : SIZE_LOAD_CHUNK ),values) ;
+		if( loop % COUNTS_PER_LINE == 0 )
+		{
+			if( loop > 0 )
+				text[used++] = '\n' ;
+			if( used > SIZE_TEXT_BUFFER - COUNTS_PER_LINE*2*(SIZE_NUMBER+1) - 8 )	// room for a whole line of the longest values
+			{
+				if( fwrite(text,1,used,outfile) != used ) return 1 ;
+				used = 0 ;
+			}
+			text[used++] = 'i' ;
+			text[used++] = 'q' ;
+			text[used++] = ':' ;
+		}
+		else
+			text[used++] = ' ' ;
+		double *value = values + 2*(loop % SIZE_LOAD_CHUNK) ;
+		if( codec->floating )			// flt4 counts are written exactly, as the doubles they convert to
+		{
+			used += format_double(value[0],text+used) ;
+			text[used++] = ' ' ;
+			used += format_double(value[1],text+used) ;
+		}
+		else
+		{
+			used += format_count(value[0],text+used) ;
+			text[used++] = ' ' ;
+			used += format_count(value[1],text+used) ;
+		}
+	}
+	text[used++] = '\n' ;
+	text[used++] = '\n' ;
+	if( fwrite(text,1,used,outfile) != used ) return 1 ;
+	return 0 ;
+}
+
+int format_count(int value, char *text)		// writes value in decimal, returns the length
+{
+	char digits[12] ;
+	int ndigits = 0 ;
+	char *p = text ;
+	unsigned int magnitude = value ;
+	if( value < 0 )
+	{
+		*p++ = '-' ;
+		magnitude = -(unsigned int )value ;
+	}
+	do
+	{
+		digits[ndigits++] = '0' + magnitude%10 ;
+		magnitude /= 10 ;
+	} while( magnitude > 0 ) ;
+	while( ndigits > 0 )
+		*p++ = digits[--ndigits] ;
+	return p - text ;
+}
+
+int read_alvl_value(char *, char, double *) ;
+int read_alvl_counts(struct parse_context *, struct sample_codec *, char *, unsigned char **, size_t *, size_t *) ;
+int grow_alvl_data(struct parse_context *, unsigned char **, size_t *, size_t) ;
+
+int make_node_alvl(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for alvl block
+{
+	struct node *newnode = new_node(context,list,KEY_alvl) ;
+	if( newnode == NULL ) return 1 ;
+	struct sample_codec *codec = find_sample_codec(config->bin_type) ;
+	if( codec == NULL )
+	{
+		printf("Unknown bin_type '%s' (%x) at index %d\n",strkey(config->bin_type),config->bin_type,config->index) ;
+		return 1;
+	}
+	size_t pair = 2*codec->width ;			// bytes of one I/Q pair
+	size_t capacity = reader->alvl_capacity ? reader->alvl_capacity : 2048 ;	// start from the size of the previous block, normally an exact fit
+	unsigned char *alvl_data = arena_alloc(&(context->slabs),capacity*pair) ;
+	if( alvl_data == NULL )
+	{
+		printf("Malloc error on '%s' data block\n",strkey(KEY_alvl)) ;
+		return 1 ;
+	}
+	newnode->data = alvl_data ;
+	size_t alvl_samples = 0 ;
+	char *line ;
+	while( (line = read_line(reader)) != NULL )	// lines of i, q values, converted into counts as they are read
+	{
+		if( strlen(line) == 0 )
+			break ;				// a blank line ends the block
+		if( line[0] == 'i' && line[1] == 'q' && line[2] == ':' )	// compact counts, no scaling involved
+		{
+			if( read_alvl_counts(context,codec,line+3,&alvl_data,&alvl_samples,&capacity) )
+			{
+				printf("Failed to read counts after sample %zu from line %s\n",alvl_samples,line) ;
+				return 1 ;
+			}
+			newnode->data = alvl_data ;
+			continue ;
+		}
+		double i ; double q ;
+		if( read_alvl_value(line,'i',&i) )
+		{
+			printf("Failed to read 'i' value %zu from line %s\n",alvl_samples,line) ;
+			return 1 ;
+		}
+		line = read_line(reader) ;
+		if( line == NULL || strlen(line) == 0 )
+		{
+			printf("Cannot deal with an odd number of lines (%zu) reading '%s' block\n",2*alvl_samples+1,strkey(KEY_alvl)) ;
+			return 1 ;
+		}
+		if( read_alvl_value(line,'q',&q) )
+		{
+			printf("Failed to read 'q' value %zu from line %s\n",alvl_samples,line) ;
+			return 1 ;
+		}
+		if( alvl_samples == capacity )		// grow the sample buffer
+		{
+			if( grow_alvl_data(context,&alvl_data,&capacity,pair) )
+			{
+				printf("Malloc error on '%s' data block\n",strkey(KEY_alvl)) ;
+				return 1 ;
+			}
+			newnode->data = alvl_data ;
+		}
+		double scaled[2] ;
+		scaled[0] = (i/config->scalar_one)*codec->factor ;
+		scaled[1] = (q/config->scalar_two)*codec->factor ;
+		if( !codec->floating )			// to the nearest count, which must fit the width like the compact counts
+		{
+			scaled[0] = round(scaled[0]) ;
+			scaled[1] = round(scaled[1]) ;
+			if( !(scaled[0] >= -codec->full_scale && scaled[0] <= codec->full_scale - 1
+				&& scaled[1] >= -codec->full_scale && scaled[1] <= codec->full_scale - 1) )	// also catches nan
+			{
+				printf("Sample %zu i:%.17g q:%.17g is out of range for '%s'\n",alvl_samples,i,q,strkey(codec->bin_type)) ;
+				return 1 ;
+			}
+		}
+		(*codec->store)(scaled,2,alvl_data+alvl_samples*pair) ;
+		alvl_samples++ ;
+	}
+	if( alvl_samples == 0 )
+	{
+		printf("Error counting lines in '%s' block\n",strkey(KEY_alvl)) ;
+		return 1 ;
+	}
+	if( alvl_samples > reader->alvl_capacity )
+		reader->alvl_capacity = alvl_samples ;
+	newnode->size = alvl_samples * pair ;
+	return 0 ;
+}
+
+int read_alvl_counts(struct parse_context *context, struct sample_codec *codec, char *text, unsigned char **alvl_data, size_t *alvl_samples, size_t *capacity)	// appends the I/Q count pairs on one "iq:" line
+{
+	long long limit = 1LL << (8*codec->width - 1) ;	// the magnitude of the most negative count
+	int32_t counts[2*COUNTS_PER_LINE] ;		// stored COUNTS_PER_LINE pairs at a time, a whole line written by tsdump
+	double values[2*COUNTS_PER_LINE] ;		// the same for flt4
+	size_t nvalues = 0 ;
+	char *p = text ;
+	while( 1 )
+	{
+		while( *p == ' ' ) p++ ;
+		if( *p == '\0' || nvalues == 2*COUNTS_PER_LINE )
+		{
+			while( *alvl_samples + nvalues/2 > *capacity )
+				if( grow_alvl_data(context,alvl_data,capacity,2*codec->width) )
+					return 1 ;
+			unsigned char *data = *alvl_data + *alvl_samples*2*codec->width ;
+			if( codec->floating )
+				(*codec->store)(values,nvalues,data) ;
+			else
+				(*codec->store_counts)(counts,nvalues,data) ;
+			*alvl_samples += nvalues/2 ;
+			nvalues = 0 ;
+			if( *p == '\0' ) return 0 ;
+		}
+		for( int loop = 0 ; loop < 2 ; loop++, nvalues++ )
+		{
+			while( *p == ' ' ) p++ ;
+			if( codec->floating )
+			{
+				char *end ;
+				values[nvalues] = parse_double(p,&end) ;
+				if( end == p ) return 1 ;
+				p = end ;
+				continue ;
+			}
+			int negative = ( *p == '-' ) ;
+			if( negative ) p++ ;
+			long long value = 0 ;
+			int ndigits = 0 ;
+			for( ; *p >= '0' && *p <= '9' && ndigits <= 10 ; p++, ndigits++ )	// enough digits to be out of range, not enough to overflow
+				value = value*10 + (*p - '0') ;
+			if( ndigits == 0 || value > limit - !negative ) return 1 ;
+			counts[nvalues] = negative ? -value : value ;
+		}
+	}
+}
+
+int grow_alvl_data(struct parse_context *context, unsigned char **alvl_data, size_t *capacity, size_t pair)	// doubles the sample buffer, in place when it is the last thing in its slab
+{
+	size_t size = *capacity*pair ;
+	unsigned char *more = arena_resize(&(context->slabs),*alvl_data,size,2*size) ;
+	if( more == NULL ) return 1 ;
+	*alvl_data = more ;
+	*capacity *= 2 ;
+	return 0 ;
+}
+
+int read_alvl_value(char *line, char name, double *value)	// parses a line of the form "i:<value>" or "q:<value>"
+{
+	if( line[0] != name || line[1] != ':' ) return 1 ;
+	char *end ;
+	*value = parse_double(line+2,&end) ;
+	if( end == line+2 ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_alvl(struct node *node, struct config *config, FILE *outfile)
+{
+	struct sample_codec *codec = sample_layout(config->bin_type) ;
+	size_t pair = 2*codec->width ;
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	size_t sample_count = node->size/pair ;
+	unsigned char chunk[SIZE_GEN_CHUNK*2*sizeof(int32_t)] ;	// samples are swapped here on the way out, the node stays in host order
+	for( size_t done = 0 ; done < sample_count ; )
+	{
+		size_t count = sample_count - done ;
+		if( count > SIZE_GEN_CHUNK )
+			count = SIZE_GEN_CHUNK ;
+		memcpy(chunk,node->data+done*pair,count*pair) ;
+		swap_samples(codec,chunk,2*count) ;
+		if( fwrite(chunk,pair,count,outfile) != count ) return 1 ;
+		done += count ;
+	}
+	return 0 ;
+}
+
+void power_wide(struct sample_codec *codec, unsigned char *data, size_t count, struct power_sum *sum)	// adds an array of fix3, fix4 or flt4 values in host order to the power totals
+{
+	double values[SIZE_LOAD_CHUNK] ;
+	for( size_t done = 0 ; done < count ; done += SIZE_LOAD_CHUNK )
+	{
+		size_t chunk = ( count-done < SIZE_LOAD_CHUNK ) ? count-done : SIZE_LOAD_CHUNK ;
+		(*codec->load)(data+done*codec->width,chunk,values) ;
+		for( size_t loop = 0 ; loop < chunk ; loop++ )
+		{
+			sum->wide_squares += values[loop]*values[loop] ;
+			if( fabs(values[loop]) > sum->wide_peak ) sum->wide_peak = fabs(values[loop]) ;
+		}
+	}
+}
+
+
+int fixup_data_end(struct node *node, struct config *config)
+{
+	return 0 ;
+}
+
+int dump_block_end(struct node *node, struct config *config, FILE *outfile)
+{
+	fprintf(outfile,"%s\n",strkey(KEY_END)) ;
+	return 0 ;
+}
+
+int make_node_end(struct parse_context *context, struct node *list, struct config *config, struct text_reader *reader)		// creates a new node for end block
+{
+	struct node *newnode = new_node(context,list,KEY_END) ;
+	if( newnode == NULL ) return 1 ;
+	return 0 ;
+}
+
+int gen_block_end(struct node *node, struct config *config, FILE *outfile)
+{
+	if( write_block_header(outfile,node->key,node->size) ) return 1 ;
+	return 0 ;
+}
+
+
+#define INDEX_MAGIC		"TSIDX\0\0\2"
+#define INDEX_BYTE_ORDER	0x01020304
+#define INDEX_SUFFIX		".tsidx"
+
+int tsindex(int argc, char *argv[])	// builds or refreshes the index sidecar of each binary file named, -l lists the sweep sets
+{
+	char *program_name = basename(argv[0]) ;
+	int list = 0 ;
+	int option ;
+	while( (option = getopt(argc,argv,"l")) != -1 )
+	{
+		switch( option )
+		{
+			case 'l':
+				list = 1 ;
+			break ;
+			default:
+				usage_tsindex(program_name) ;
+				return 1 ;
+		}
+	}
+	if( optind >= argc )
+	{
+		usage_tsindex(program_name) ;
+		return 0 ;
+	}
+	int err = 0 ;
+	for( int arg = optind ; arg < argc ; arg++ )
+	{
+		char *filename = argv[arg] ;
+		int fd = open(filename,O_RDONLY) ;
+		if( fd < 0 )
+		{
+			printf("Cannot open input file '%s'\n",filename) ;
+			err = 1 ;
+			continue ;
+		}
+		struct sweep_index index ;
+		if( load_index(filename,fd,&index) )
+		{
+			err = 1 ;
+			close(fd) ;
+			continue ;
+		}
+		printf("%s: %llu sweep sets\n",filename,(unsigned long long )index.header.count) ;
+		for( uint64_t loop = 0 ; list && loop < index.header.count ; loop++ )
+		{
+			struct index_entry *entry = &(index.entries[loop]) ;
+			printf("sweep:%llu offset:%llu length:%u index:%u gtag:%u atag:%u scalar_one:%.20lf scalar_two:%.20lf alvl:%u",
+				(unsigned long long )loop+1,(unsigned long long )entry->offset,entry->length,entry->index,entry->gtag,entry->atag,entry->scalar_one,entry->scalar_two,entry->nalvl) ;
+			for( uint32_t channel = 0 ; channel < entry->nalvl && channel < INDEX_MAX_CHANNELS ; channel++ )
+				printf("%c%u",( channel == 0 ) ? ':' : ',',entry->alvl_size[channel]) ;
+			printf("\n") ;
+		}
+		free_index(&index) ;
+		close(fd) ;
+	}
+	return err ;
+}
+
+void usage_tsindex(char *name)
+{
+	printf("Usage: %s [-l] infile ...\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Builds the sweep set index sidecar (%s) of each binary infile, if it is missing or out of date.\n",INDEX_SUFFIX) ;
+	printf("  -l  list the sweep sets\n") ;
+}
+
+char *index_filename(char *filename)	// returns a malloc'd name for the sidecar: the binary file name with .ts replaced by .tsidx
+{
+	size_t length = strlen(filename) ;
+	char *name = malloc(length + sizeof(INDEX_SUFFIX)) ;
+	if( name == NULL ) return NULL ;
+	strcpy(name,filename) ;
+	if( length > 3 && strcmp(name+length-3,".ts") == 0 )
+		name[length-3] = '\0' ;
+	strcat(name,INDEX_SUFFIX) ;
+	return name ;
+}
+
+int load_index(char *filename, int fd, struct sweep_index *index)	// reads the sidecar if it matches the binary file, otherwise builds the index and saves it
+{
+	memset(index,0,sizeof(struct sweep_index)) ;
+	struct stat st ;
+	if( fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) )
+	{
+		printf("Cannot index '%s', it is not a regular file\n",filename) ;
+		return 1 ;
+	}
+	char *name = index_filename(filename) ;
+	if( name == NULL )
+	{
+		printf("Malloc error on index file name\n") ;
+		return 1 ;
+	}
+	if( read_index(name,&st,index) == 0 )
+	{
+		free(name) ;
+		return 0 ;
+	}
+	if( build_index(fd,&st,index) )
+	{
+		free(name) ;
+		return 1 ;
+	}
+	if( write_index(name,index) )
+		printf("Cannot write index file '%s', continuing without it\n",name) ;
+	free(name) ;
+	return 0 ;
+}
+
+int build_index(int fd, struct stat *st, struct sweep_index *index)	// walks the block headers of BODY, reading only the small blocks, never the alvl data
+{
+	memset(index,0,sizeof(struct sweep_index)) ;
+	memcpy(index->header.magic,INDEX_MAGIC,sizeof(index->header.magic)) ;
+	index->header.byte_order = INDEX_BYTE_ORDER ;
+	index->header.entry_size = sizeof(struct index_entry) ;
+	index->header.file_size = st->st_size ;
+	index->header.file_mtime = st->st_mtime ;
+	index->header.file_mtime_nsec = STAT_MTIME_NSEC(st) ;
+	index->header.file_inode = st->st_ino ;
+	unsigned char buffer[sizeof(struct block_header)+sizeof(struct block_scal)] ;	// a header plus the largest small block we look at
+	struct block_header *header = (struct block_header *)buffer ;
+	if( pread(fd,buffer,sizeof(struct block_header),0) != sizeof(struct block_header) || check_header(buffer) )
+		return 1 ;
+	uint64_t offset = sizeof(struct block_header) ;		// step inside AQVL
+	uint64_t limit = st->st_size ;
+	struct index_entry *entry = NULL ;
+	int previous_alvl = 0 ;
+	while( offset + sizeof(struct block_header) <= limit )
+	{
+		ssize_t count = pread(fd,buffer,sizeof(buffer),offset) ;
+		if( count < (ssize_t )sizeof(struct block_header) )
+			break ;
+		fourcc key = header->key ;
+		endian_fixup(&key,sizeof(key)) ;
+		uint32_t size = header->size ;
+		endian_fixup(&size,sizeof(size)) ;
+		unsigned char *data = buffer + sizeof(struct block_header) ;
+		uint64_t next = offset + sizeof(struct block_header) + size ;
+		if( index->header.body_offset == 0 )		// still looking for BODY
+		{
+			if( key == KEY_BODY )
+			{
+				index->header.body_offset = offset ;
+				limit = ( next < limit ) ? next : limit ;	// only walk the blocks inside BODY
+				offset += sizeof(struct block_header) ;
+			}
+			else
+				offset = next ;
+			continue ;
+		}
+		if( entry == NULL || (previous_alvl && key != KEY_alvl) )	// the first block after a run of alvl blocks starts a new sweep set
+		{
+			entry = add_index_entry(index,offset) ;
+			if( entry == NULL )
+				return 1 ;
+		}
+		previous_alvl = ( key == KEY_alvl ) ;
+		if( size <= count - sizeof(struct block_header) )	// the small blocks are read whole with their header
+		{
+			if( key == KEY_gtag && size >= sizeof(struct block_gtag) )
+			{
+				endian_fixup(data,sizeof(uint32_t)) ;
+				memcpy(&(entry->gtag),data,sizeof(uint32_t)) ;
+			}
+			if( key == KEY_atag && size >= sizeof(struct block_atag) )
+			{
+				endian_fixup(data,sizeof(uint32_t)) ;
+				memcpy(&(entry->atag),data,sizeof(uint32_t)) ;
+			}
+			if( key == KEY_indx && size >= sizeof(struct block_indx) )
+			{
+				endian_fixup(data,sizeof(uint32_t)) ;
+				memcpy(&(entry->index),data,sizeof(uint32_t)) ;
+			}
+			if( key == KEY_scal && size >= sizeof(struct block_scal) )
+			{
+				endian_fixup(data,sizeof(double)) ;
+				memcpy(&(entry->scalar_one),data,sizeof(double)) ;
+				endian_fixup(data+sizeof(double),sizeof(double)) ;
+				memcpy(&(entry->scalar_two),data+sizeof(double),sizeof(double)) ;
+			}
+		}
+		if( key == KEY_alvl )
+		{
+			if( entry->nalvl < INDEX_MAX_CHANNELS )
+				entry->alvl_size[entry->nalvl] = size ;
+			entry->nalvl++ ;
+		}
+		if( next > limit )
+		{
+			printf("Block '%s' at offset %llu is truncated\n",strkey(key),(unsigned long long )offset) ;
+			next = limit ;
+		}
+		entry->length = next - entry->offset ;
+		offset = next ;
+	}
+	index->header.end_offset = ( index->header.body_offset != 0 ) ? limit : 0 ;
+	return 0 ;
+}
+
+struct index_entry *add_index_entry(struct sweep_index *index, uint64_t offset)	// appends a zeroed entry for a sweep set starting at offset
+{
+	if( index->header.count == index->allocated )
+	{
+		size_t allocated = index->allocated ? 2*index->allocated : 1024 ;
+		struct index_entry *entries = realloc(index->entries,allocated*sizeof(struct index_entry)) ;
+		if( entries == NULL )
+		{
+			printf("Cannot get memory for %zu index entries\n",allocated) ;
+			return NULL ;
+		}
+		index->entries = entries ;
+		index->allocated = allocated ;
+	}
+	struct index_entry *entry = &(index->entries[index->header.count++]) ;
+	memset(entry,0,sizeof(struct index_entry)) ;
+	entry->offset = offset ;
+	return entry ;
+}
+
+int read_index(char *name, struct stat *st, struct sweep_index *index)	// loads a sidecar, returns 1 if it is missing or does not match the binary file
+{
+	memset(index,0,sizeof(struct sweep_index)) ;
+	FILE *fd = fopen(name,"rb") ;
+	if( fd == NULL ) return 1 ;
+	struct index_header *header = &(index->header) ;
+	int err = ( fread(header,sizeof(struct index_header),1,fd) != 1 ) ;
+	if( !err )
+		err = ( memcmp(header->magic,INDEX_MAGIC,sizeof(header->magic)) != 0
+			|| header->byte_order != INDEX_BYTE_ORDER
+			|| header->entry_size != sizeof(struct index_entry)
+			|| header->file_size != (uint64_t )st->st_size
+			|| header->file_mtime != (int64_t )st->st_mtime	// stale: the binary file has changed since
+			|| header->file_mtime_nsec != (int64_t )STAT_MTIME_NSEC(st)
+			|| header->file_inode != (uint64_t )st->st_ino ) ;
+	struct stat index_stat ;
+	if( !err )			// the count must be what the sidecar holds, before it sizes a malloc()
+		err = ( fstat(fileno(fd),&index_stat) != 0
+			|| header->count != ((uint64_t )index_stat.st_size - sizeof(struct index_header)) / sizeof(struct index_entry)
+			|| ((uint64_t )index_stat.st_size - sizeof(struct index_header)) % sizeof(struct index_entry) != 0 ) ;
+	if( !err && header->count > 0 )
+	{
+		index->entries = malloc(header->count*sizeof(struct index_entry)) ;
+		err = ( index->entries == NULL || fread(index->entries,sizeof(struct index_entry),header->count,fd) != header->count ) ;
+		index->allocated = header->count ;
+	}
+	fclose(fd) ;
+	if( err )
+		free_index(index) ;
+	return err ;
+}
+
+int write_index(char *name, struct sweep_index *index)	// saves the index under a temporary name, then renames it so readers never see a partial file
+{
+	char *temporary = malloc(strlen(name) + 5) ;
+	if( temporary == NULL ) return 1 ;
+	sprintf(temporary,"%s.tmp",name) ;
+	FILE *fd = fopen(temporary,"wb") ;
+	if( fd == NULL )
+	{
+		free(temporary) ;
+		return 1 ;
+	}
+	int err = ( fwrite(&(index->header),sizeof(struct index_header),1,fd) != 1 ) ;
+	if( !err && index->header.count > 0 )
+		err = ( fwrite(index->entries,sizeof(struct index_entry),index->header.count,fd) != index->header.count ) ;
+	if( fclose(fd) != 0 ) err = 1 ;
+	if( !err )
+		err = ( rename(temporary,name) != 0 ) ;
+	if( err )
+		unlink(temporary) ;
+	free(temporary) ;
+	return err ;
+}
+
+void free_index(struct sweep_index *index)
+{
+	free(index->entries) ;
+	index->entries = NULL ;
+	index->allocated = 0 ;
+	index->header.count = 0 ;
+}
+
+#define SIZE_COPY_BUFFER (1024*1024)	// block data is copied between binary files through a buffer this big
+
+int tsedit(int argc, char *argv[])	// writes a copy of a binary file without the sweep sets selected for deletion, the data is copied without decoding it
+{
+	char *program_name = basename(argv[0]) ;
+	struct range_list positions ;		// sweep sets to delete, counted from 1
+	struct range_list indexes ;		// sweep sets to delete, by indx value
+	memset(&positions,0,sizeof(struct range_list)) ;
+	memset(&indexes,0,sizeof(struct range_list)) ;
+	int option ;
+	while( (option = getopt(argc,argv,"d:x:")) != -1 )
+	{
+		switch( option )
+		{
+			case 'd':
+				if( parse_ranges(optarg,&positions) ) return 1 ;
+			break ;
+			case 'x':
+				if( parse_ranges(optarg,&indexes) ) return 1 ;
+			break ;
+			default:
+				usage_tsedit(program_name) ;
+				return 1 ;
+		}
+	}
+	if( argc - optind < 2 || (positions.count == 0 && indexes.count == 0) )
+	{
+		usage_tsedit(program_name) ;
+		return 0 ;
+	}
+	char *infilename = argv[optind] ;
+	char *outfilename = argv[optind+1] ;
+	int fd = open(infilename,O_RDONLY) ;
+	if( fd < 0 )
+	{
+		printf("Cannot open input file '%s'\n",infilename) ;
+		return 1 ;
+	}
+	struct stat in_stat ;
+	struct stat out_stat ;
+	if( fstat(fd,&in_stat) == 0 && stat(outfilename,&out_stat) == 0 && in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino )
+	{
+		printf("The output file '%s' is the input file\n",outfilename) ;
+		close(fd) ;
+		return 1 ;
+	}
+	struct sweep_index index ;
+	if( load_index(infilename,fd,&index) )
+	{
+		close(fd) ;
+		return 1 ;
+	}
+	struct block_header aqlv ;
+	struct block_header body ;
+	int err = ( index.header.body_offset == 0
+		|| pread(fd,&aqlv,sizeof(struct block_header),0) != sizeof(struct block_header)
+		|| pread(fd,&body,sizeof(struct block_header),index.header.body_offset) != sizeof(struct block_header) ) ;
+	if( err )
+		printf("Cannot find the BODY block in '%s'\n",infilename) ;
+	unsigned char *keep = calloc(index.header.count+1,1) ;	// 1 for each sweep set that is copied
+	unsigned char *buffer = malloc(SIZE_COPY_BUFFER) ;
+	size_t head_size = err ? 0 : index.header.body_offset - sizeof(struct block_header) ;	// the blocks between the AQVL and BODY headers
+	unsigned char *head = malloc(head_size+1) ;
+	FILE *outfile = NULL ;
+	if( !err && (keep == NULL || buffer == NULL || head == NULL) )
+	{
+		printf("Cannot get memory to copy '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	if( !err && pread(fd,head,head_size,sizeof(struct block_header)) != (ssize_t )head_size )
+	{
+		printf("Error reading the header of '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	uint64_t removed = 0 ;			// bytes of the sweep sets being deleted
+	uint64_t deleted = 0 ;
+	for( uint64_t loop = 0 ; !err && loop < index.header.count ; loop++ )
+	{
+		struct index_entry *entry = &(index.entries[loop]) ;
+		keep[loop] = !( in_ranges(&positions,loop+1) || in_ranges(&indexes,entry->index) ) ;
+		if( !keep[loop] )
+		{
+			removed += entry->length ;
+			deleted++ ;
+		}
+	}
+	if( !err && (outfile = fopen(outfilename,"wb")) == NULL )
+	{
+		printf("Cannot open output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( !err )
+	{
+		endian_fixup(&(aqlv.size),sizeof(aqlv.size)) ;
+		endian_fixup(&(body.size),sizeof(body.size)) ;
+		set_head_nsweeps(head,head_size,index.header.count-deleted) ;	// the blocks in front of BODY are copied with only nsweeps changed, as tssplit does
+		err = write_block_header(outfile,KEY_AQLV,aqlv.size-removed)
+			|| fwrite(head,head_size,1,outfile) != 1
+			|| write_block_header(outfile,KEY_BODY,body.size-removed) ;
+	}
+	for( uint64_t loop = 0 ; !err && loop < index.header.count ; loop++ )
+	{
+		if( !keep[loop] ) continue ;
+		uint64_t offset = index.entries[loop].offset ;	// copy each run of kept sweep sets in one go
+		uint64_t length = 0 ;
+		for( ; loop < index.header.count && keep[loop] ; loop++ )
+			length += index.entries[loop].length ;
+		err = copy_range(fd,offset,length,outfile,buffer) ;
+	}
+	if( !err )				// anything after BODY, normally just END
+		err = copy_range(fd,index.header.end_offset,index.header.file_size-index.header.end_offset,outfile,buffer) ;
+	if( outfile != NULL && fclose(outfile) != 0 && !err )
+	{
+		printf("Error writing output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( err && outfile != NULL )
+		unlink(outfilename) ;		// its AQVL and BODY sizes are written first, a partial file would pass for a good one
+	if( !err )
+		printf("Deleted %llu of %llu sweep sets\n",(unsigned long long )deleted,(unsigned long long )index.header.count) ;
+	free(head) ;
+	free(buffer) ;
+	free(keep) ;
+	free_index(&index) ;
+	free_ranges(&positions) ;
+	free_ranges(&indexes) ;
+	close(fd) ;
+	return err ;
+}
+
+void usage_tsedit(char *name)
+{
+	printf("Usage: %s [-d positions] [-x indexes] infile outfile\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Copies binary infile to binary outfile without the selected sweep sets, with the cnst nsweeps set to the number kept.\n") ;
+	printf("  -d  delete sweep sets by position, counted from 1, e.g. 1-100,150\n") ;
+	printf("  -x  delete sweep sets by their indx value, e.g. 12-40\n") ;
+}
+
+int copy_range(int fd, uint64_t offset, uint64_t length, FILE *outfile, unsigned char *buffer)	// copies length bytes of the binary file from offset to outfile
+{
+	while( length > 0 )
+	{
+		size_t chunk = ( length < SIZE_COPY_BUFFER ) ? length : SIZE_COPY_BUFFER ;
+		ssize_t count = pread(fd,buffer,chunk,offset) ;
+		if( count <= 0 )
+		{
+			printf("Error reading ts file at offset %llu\n",(unsigned long long )offset) ;
+			return 1 ;
+		}
+		if( fwrite(buffer,count,1,outfile) != 1 )
+		{
+			printf("Error writing %zd bytes\n",count) ;
+			return 1 ;
+		}
+		offset += count ;
+		length -= count ;
+	}
+	return 0 ;
+}
+
+int write_block_header(FILE *outfile, fourcc key, uint32_t size)	// writes a big endian block header
+{
+	struct block_header header ;
+	header.key = key ;
+	header.size = size ;
+	endian_fixup(&(header.key),sizeof(header.key)) ;
+	endian_fixup(&(header.size),sizeof(header.size)) ;
+	if( fwrite(&header,sizeof(struct block_header),1,outfile) != 1 )
+	{
+		printf("Error writing '%s' block header\n",strkey(key)) ;
+		return 1 ;
+	}
+	return 0 ;
+}
+
+int parse_ranges(char *text, struct range_list *list)	// adds the comma separated ranges in text to list, a range is a number or first-last
+{
+	char *next = text ;
+	while( *next != '\0' )
+	{
+		char *end ;
+		struct range range ;
+		range.first = strtoull(next,&end,10) ;
+		range.last = range.first ;
+		if( end != next && *end == '-' )
+		{
+			next = end + 1 ;
+			range.last = strtoull(next,&end,10) ;
+		}
+		if( end == next || (*end != ',' && *end != '\0') || range.last < range.first )
+		{
+			printf("Bad range list '%s'\n",text) ;
+			return 1 ;
+		}
+		if( list->count == list->allocated )
+		{
+			size_t allocated = list->allocated ? 2*list->allocated : 16 ;
+			struct range *ranges = realloc(list->ranges,allocated*sizeof(struct range)) ;
+			if( ranges == NULL )
+			{
+				printf("Cannot get memory for %zu ranges\n",allocated) ;
+				return 1 ;
+			}
+			list->ranges = ranges ;
+			list->allocated = allocated ;
+		}
+		list->ranges[list->count++] = range ;
+		next = ( *end == ',' ) ? end + 1 : end ;
+	}
+	return 0 ;
+}
+
+int in_ranges(struct range_list *list, uint64_t value)	// returns 1 if value is in one of the ranges
+{
+	for( size_t loop = 0 ; loop < list->count ; loop++ )
+	{
+		if( value >= list->ranges[loop].first && value <= list->ranges[loop].last )
+			return 1 ;
+	}
+	return 0 ;
+}
+
+void free_ranges(struct range_list *list)
+{
+	free(list->ranges) ;
+	memset(list,0,sizeof(struct range_list)) ;
+}
+
+#define FIELD_INT32	1		// signed decimal
+#define FIELD_HEX32	2		// unsigned hexadecimal
+#define FIELD_DOUBLE	3		// 8 byte floating point
+#define FIELD_FOURCC	4		// 4 characters
+#define FIELD_TEXT	5		// fixed size character array, zero padded
+#define MAX_FIELDS	32		// assignments on one tspatch command line
+#define SIZE_FIELD_TEXT	512		// longest field decode_field() writes, a double in %.20lf format needs up to 331
+
+struct patch_field						// a fixed size header field that tspatch can overwrite in place
+{
+	fourcc key ;						// the block that holds it
+	char *name ;						// the name tsdump gives the field
+	int type ;						// FIELD_INT32 etc.
+	size_t offset ;						// offset from the start of the block data
+	size_t size ;						// bytes in the file
+} ;
+
+struct patch_field Global_patch_fields[] =			// the fields of the fixed size HEAD blocks, by the names tsdump uses
+{
+	{ KEY_sign, "version", FIELD_FOURCC, offsetof(struct block_sign,version), sizeof(fourcc) },
+	{ KEY_sign, "filetype", FIELD_FOURCC, offsetof(struct block_sign,filetype), sizeof(fourcc) },
+	{ KEY_sign, "sitecode", FIELD_FOURCC, offsetof(struct block_sign,sitecode), sizeof(fourcc) },
+	{ KEY_sign, "userflags", FIELD_HEX32, offsetof(struct block_sign,userflags), sizeof(uint32_t) },
+	{ KEY_sign, "description", FIELD_TEXT, offsetof(struct block_sign,description), SIZE_DESCRIPTION },
+	{ KEY_sign, "ownername", FIELD_TEXT, offsetof(struct block_sign,ownername), SIZE_OWNERNAME },
+	{ KEY_sign, "comment", FIELD_TEXT, offsetof(struct block_sign,comment), SIZE_COMMENT },
+	{ KEY_cnst, "nchannels", FIELD_INT32, offsetof(struct block_cnst,nchannels), sizeof(int32_t) },
+	{ KEY_cnst, "nsweeps", FIELD_INT32, offsetof(struct block_cnst,nsweeps), sizeof(int32_t) },
+	{ KEY_cnst, "nsamples", FIELD_INT32, offsetof(struct block_cnst,nsamples), sizeof(int32_t) },
+	{ KEY_cnst, "iqindicator", FIELD_INT32, offsetof(struct block_cnst,iqindicator), sizeof(int32_t) },
+	{ KEY_swep, "samplespersweep", FIELD_INT32, offsetof(struct block_swep,samplespersweep), sizeof(int32_t) },
+	{ KEY_swep, "sweepstart", FIELD_DOUBLE, offsetof(struct block_swep,sweepstart), sizeof(double) },
+	{ KEY_swep, "sweepbandwidth", FIELD_DOUBLE, offsetof(struct block_swep,sweepbandwidth), sizeof(double) },
+	{ KEY_swep, "sweeprate", FIELD_DOUBLE, offsetof(struct block_swep,sweeprate), sizeof(double) },
+	{ KEY_swep, "rangeoffset", FIELD_INT32, offsetof(struct block_swep,rangeoffset), sizeof(int32_t) },
+	{ KEY_fbin, "format", FIELD_FOURCC, offsetof(struct block_fbin,bin_format), sizeof(fourcc) },
+	{ KEY_fbin, "type", FIELD_FOURCC, offsetof(struct block_fbin,bin_type), sizeof(fourcc) },
+	{ 0, NULL, 0, 0, 0 }
+} ;
+
+int tspatch(int argc, char *argv[])	// overwrites header fields of a binary file in place, only the HEAD block headers are read
+{
+	char *program_name = basename(argv[0]) ;
+	if( argc < 3 )
+	{
+		usage_tspatch(program_name) ;
+		return 0 ;
+	}
+	int nfields = argc - 2 ;
+	if( nfields > MAX_FIELDS )
+	{
+		printf("Too many fields, at most %d at a time\n",MAX_FIELDS) ;
+		return 1 ;
+	}
+	struct patch_field *fields[MAX_FIELDS] ;
+	unsigned char values[MAX_FIELDS][SIZE_DESCRIPTION] ;	// the new field contents, as they go in the file
+	for( int loop = 0 ; loop < nfields ; loop++ )		// check every assignment before touching the file
+	{
+		char *value ;
+		if( (fields[loop] = find_patch_field(argv[loop+2],&value)) == NULL )
+			return 1 ;
+		if( encode_field(fields[loop],value,values[loop]) )
+			return 1 ;
+	}
+	char *filename = argv[1] ;
+	int fd = open(filename,O_RDWR) ;
+	if( fd < 0 )
+	{
+		printf("Cannot open file '%s' for writing\n",filename) ;
+		return 1 ;
+	}
+	off_t offsets[MAX_FIELDS] ;				// where each field is in the file, 0 until its block is found
+	memset(offsets,0,sizeof(offsets)) ;
+	struct block_header header ;
+	int err = ( pread(fd,&header,sizeof(struct block_header),0) != sizeof(struct block_header) || check_header((unsigned char *)&header) ) ;
+	off_t offset = sizeof(struct block_header) ;		// step inside AQVL
+	off_t head_end = 0 ;					// offset just past HEAD, 0 until HEAD is found
+	while( !err && pread(fd,&header,sizeof(struct block_header),offset) == sizeof(struct block_header) )
+	{
+		fourcc key = header.key ;
+		endian_fixup(&key,sizeof(key)) ;
+		uint32_t size = header.size ;
+		endian_fixup(&size,sizeof(size)) ;
+		if( key == KEY_BODY || key == KEY_END || (head_end != 0 && offset >= head_end) )
+			break ;
+		if( key == KEY_HEAD )
+		{
+			head_end = offset + sizeof(struct block_header) + size ;
+			offset += sizeof(struct block_header) ;	// step inside HEAD
+			continue ;
+		}
+		for( int loop = 0 ; head_end != 0 && loop < nfields ; loop++ )
+		{
+			if( fields[loop]->key != key ) continue ;
+			if( fields[loop]->offset + fields[loop]->size > size )
+			{
+				printf("Block '%s' is truncated\n",strkey(key)) ;
+				err = 1 ;
+			}
+			offsets[loop] = offset + sizeof(struct block_header) + fields[loop]->offset ;
+		}
+		offset += sizeof(struct block_header) + size ;
+	}
+	for( int loop = 0 ; !err && loop < nfields ; loop++ )
+	{
+		if( offsets[loop] == 0 )
+		{
+			printf("Cannot find block '%s' in HEAD\n",strkey(fields[loop]->key)) ;
+			err = 1 ;
+		}
+	}
+	for( int loop = 0 ; !err && loop < nfields ; loop++ )
+	{
+		struct patch_field *field = fields[loop] ;
+		unsigned char old[SIZE_DESCRIPTION] ;
+		char old_text[SIZE_FIELD_TEXT] ;
+		char new_text[SIZE_FIELD_TEXT] ;
+		if( pread(fd,old,field->size,offsets[loop]) != (ssize_t )field->size
+			|| pwrite(fd,values[loop],field->size,offsets[loop]) != (ssize_t )field->size )
+		{
+			printf("Error patching '%s.%s'\n",strkey(field->key),field->name) ;
+			err = 1 ;
+			break ;
+		}
+		decode_field(field,old,old_text) ;
+		decode_field(field,values[loop],new_text) ;
+		printf("%s.%s:%s -> %s\n",strkey(field->key),field->name,old_text,new_text) ;
+	}
+	if( close(fd) != 0 ) err = 1 ;
+	return err ;
+}
+
+void usage_tspatch(char *name)
+{
+	printf("Usage: %s binary_file block.field=value ...\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Overwrites header fields of binary_file in place, e.g. swep.sweeprate=2\n") ;
+	printf("Fields:") ;
+	for( struct patch_field *field = Global_patch_fields ; field->key != 0 ; field++ )
+		printf(" %s.%s",strkey(field->key),field->name) ;
+	printf("\n") ;
+}
+
+struct patch_field *find_patch_field(char *assignment, char **value)	// looks up the field named in "block.field=value", sets value to point at the value
+{
+	char *dot = strchr(assignment,'.') ;
+	char *equals = strchr(assignment,'=') ;
+	if( dot == NULL || equals == NULL || dot > equals || dot - assignment != sizeof(fourcc) )
+	{
+		printf("Bad field assignment '%s', expected block.field=value\n",assignment) ;
+		return NULL ;
+	}
+	for( struct patch_field *field = Global_patch_fields ; field->key != 0 ; field++ )
+	{
+		if( memcmp(strkey(field->key),assignment,sizeof(fourcc)) == 0
+			&& strlen(field->name) == (size_t )(equals - dot - 1) && memcmp(field->name,dot+1,equals-dot-1) == 0 )
+		{
+			*value = equals + 1 ;
+			return field ;
+		}
+	}
+	printf("Unknown field '%.*s'\n",(int )(equals-assignment),assignment) ;
+	return NULL ;
+}
+
+int encode_field(struct patch_field *field, char *text, unsigned char *bytes)	// converts text into the big endian bytes of the field
+{
+	char *end = NULL ;					// just past the value once it has been converted
+	switch( field->type )
+	{
+		case FIELD_INT32:
+		{
+			long value = strtol(text,&end,10) ;
+			int32_t number = value ;
+			if( number != value ) end = NULL ;
+			memcpy(bytes,&number,sizeof(number)) ;
+			endian_fixup(bytes,sizeof(number)) ;
+		}
+		break ;
+		case FIELD_HEX32:
+		{
+			unsigned long value = strtoul(text,&end,16) ;
+			uint32_t number = value ;
+			if( number != value ) end = NULL ;
+			memcpy(bytes,&number,sizeof(number)) ;
+			endian_fixup(bytes,sizeof(number)) ;
+		}
+		break ;
+		case FIELD_DOUBLE:
+		{
+			double number = strtod(text,&end) ;
+			memcpy(bytes,&number,sizeof(number)) ;
+			endian_fixup(bytes,sizeof(number)) ;
+		}
+		break ;
+		case FIELD_FOURCC:
+			if( strlen(text) == sizeof(fourcc) )	// the characters are stored in order
+			{
+				memcpy(bytes,text,sizeof(fourcc)) ;
+				end = text + sizeof(fourcc) ;
+			}
+		break ;
+		case FIELD_TEXT:
+			if( strlen(text) <= field->size )
+			{
+				memset(bytes,0,field->size) ;
+				memcpy(bytes,text,strlen(text)) ;
+				end = text + strlen(text) ;
+			}
+		break ;
+	}
+	if( end == NULL || *end != '\0' || (end == text && field->type != FIELD_TEXT) )
+	{
+		printf("Bad value '%s' for field '%s.%s'\n",text,strkey(field->key),field->name) ;
+		return 1 ;
+	}
+	return 0 ;
+}
+
+void decode_field(struct patch_field *field, unsigned char *bytes, char *text)	// formats the big endian bytes of the field the way tsdump does
+{
+	unsigned char data[sizeof(double)] ;
+	if( field->size <= sizeof(data) )
+	{
+		memcpy(data,bytes,field->size) ;
+		endian_fixup(data,field->size) ;
+	}
+	switch( field->type )
+	{
+		case FIELD_INT32:
+		{
+			int32_t number ;
+			memcpy(&number,data,sizeof(number)) ;
+			sprintf(text,"%d",number) ;
+		}
+		break ;
+		case FIELD_HEX32:
+		{
+			uint32_t number ;
+			memcpy(&number,data,sizeof(number)) ;
+			sprintf(text,"%x",number) ;
+		}
+		break ;
+		case FIELD_DOUBLE:
+		{
+			double number ;
+			memcpy(&number,data,sizeof(number)) ;
+			sprintf(text,"%.20lf",number) ;
+		}
+		break ;
+		case FIELD_FOURCC:
+		case FIELD_TEXT:
+			sprintf(text,"%.*s",(int )field->size,(char *)bytes) ;
+		break ;
+	}
+}
+
+#define STAT_THRESHOLD	10.0		// default power change in dB that tsstat reports as a configuration change
+
+int tsstat(int argc, char *argv[])	// reads a binary file once, front to back, and reports the power of each sweep set and where the receiver configuration changes
+{
+	char *program_name = basename(argv[0]) ;
+	struct stat_state state ;
+	memset(&state,0,sizeof(struct stat_state)) ;
+	state.threshold = STAT_THRESHOLD ;
+	state.codec = find_sample_codec(0) ;			// fix2, unless the fbin block says otherwise
+	int option ;
+	while( (option = getopt(argc,argv,"lt:")) != -1 )
+	{
+		switch( option )
+		{
+			case 'l':
+				state.list = 1 ;
+			break ;
+			case 't':
+				state.threshold = strtod(optarg,NULL) ;
+			break ;
+			default:
+				usage_tsstat(program_name) ;
+				return 1 ;
+		}
+	}
+	if( optind >= argc )
+	{
+		usage_tsstat(program_name) ;
+		return 0 ;
+	}
+	char *filename = argv[optind] ;
+	FILE *infile = ( strcmp(filename,"-") == 0 ) ? stdin : fopen(filename,"rb") ;
+	if( infile == NULL )
+	{
+		printf("Cannot open input file '%s'\n",filename) ;
+		return 1 ;
+	}
+	unsigned char *buffer = NULL ;				// block data, grown to the largest block
+	size_t buffer_size = 0 ;
+	struct block_header header ;
+	int err = ( fread(&header,sizeof(struct block_header),1,infile) != 1 || check_header((unsigned char *)&header) ) ;
+	int in_body = 0 ;
+	int previous_alvl = 0 ;
+	state.segment_start = 1 ;
+	while( !err && fread(&header,sizeof(struct block_header),1,infile) == 1 )
+	{
+		fourcc key = header.key ;
+		endian_fixup(&key,sizeof(key)) ;
+		uint32_t size = header.size ;
+		endian_fixup(&size,sizeof(size)) ;
+		if( superblock(key) )			// step inside, its sub blocks follow
+		{
+			in_body = ( key == KEY_BODY ) ;
+			continue ;
+		}
+		if( size > buffer_size )
+		{
+			free(buffer) ;
+			if( (buffer = malloc(size)) == NULL )
+			{
+				printf("Cannot get memory for %u bytes of block '%s'\n",size,strkey(key)) ;
+				err = 1 ;
+				break ;
+			}
+			buffer_size = size ;
+		}
+		if( fread(buffer,1,size,infile) != size )
+		{
+			printf("Block '%s' is truncated\n",strkey(key)) ;
+			err = 1 ;
+			break ;
+		}
+		if( key == KEY_fbin && size >= sizeof(struct block_fbin) )
+		{
+			fourcc bin_type ;
+			memcpy(&bin_type,buffer+sizeof(fourcc),sizeof(fourcc)) ;
+			endian_fixup(&bin_type,sizeof(bin_type)) ;
+			if( (state.codec = find_sample_codec(bin_type)) == NULL )
+			{
+				printf("Unknown bin_type '%s' (%x)\n",strkey(bin_type),bin_type) ;
+				err = 1 ;
+				break ;
+			}
+		}
+		if( !in_body )
+			continue ;
+		struct sweep_stats *sweep = &(state.current) ;
+		if( sweep->position == 0 || (previous_alvl && key != KEY_alvl) )	// the first block after a run of alvl blocks starts a new sweep set
+		{
+			if( sweep->position > 0 )
+				err = finish_sweep_stats(&state) ;
+			uint64_t position = sweep->position + 1 ;
+			memset(sweep,0,sizeof(struct sweep_stats)) ;
+			sweep->position = position ;
+		}
+		previous_alvl = ( key == KEY_alvl ) ;
+		if( key == KEY_indx && size >= sizeof(struct block_indx) )
+		{
+			endian_fixup(buffer,sizeof(uint32_t)) ;
+			memcpy(&(sweep->index),buffer,sizeof(uint32_t)) ;
+		}
+		if( key == KEY_scal && size >= sizeof(struct block_scal) )
+		{
+			endian_fixup(buffer,sizeof(double)) ;
+			memcpy(&(sweep->scalar_one),buffer,sizeof(double)) ;
+			endian_fixup(buffer+sizeof(double),sizeof(double)) ;
+			memcpy(&(sweep->scalar_two),buffer+sizeof(double),sizeof(double)) ;
+		}
+		if( key == KEY_alvl )
+		{
+			if( sweep->nalvl < INDEX_MAX_CHANNELS )	// fix2 samples are summed without byte swapping them first
+			{
+				struct sample_codec *codec = state.codec ;
+				uint64_t npairs = size/(2*codec->width) ;
+				sweep->npairs[sweep->nalvl] = npairs ;
+				if( codec->bin_type == BINTYPE_FIX2 )
+					(*swap_kernel()->power16)(buffer,2*npairs,&(sweep->power[sweep->nalvl])) ;
+				else
+				{
+					swap_samples(codec,buffer,2*npairs) ;
+					power_wide(codec,buffer,2*npairs,&(sweep->power[sweep->nalvl])) ;
+				}
+			}
+			sweep->nalvl++ ;
+		}
+	}
+	if( !err && state.current.position > 0 )
+		err = finish_sweep_stats(&state) ;
+	if( !err )
+	{
+		printf("segment:%llu-%llu\n",(unsigned long long )state.segment_start,(unsigned long long )state.current.position) ;
+		printf("%llu sweep sets, %llu configuration changes\n",(unsigned long long )state.current.position,(unsigned long long )state.changes) ;
+	}
+	free(buffer) ;
+	if( infile != stdin ) fclose(infile) ;
+	return err ;
+}
+
+void usage_tsstat(char *name)
+{
+	printf("Usage: %s [-l] [-t dB] infile\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Reports the sweep sets of binary infile ('-' for stdin) where the receiver configuration changes,\n") ;
+	printf("found from changes of the 'scal' values or of the power of the 'alvl' samples.\n") ;
+	printf("  -l  list the RMS and peak counts of each channel of each sweep set\n") ;
+	printf("  -t  power change in dB that counts as a configuration change, default %g, 0 to ignore power\n",STAT_THRESHOLD) ;
+}
+
+int finish_sweep_stats(struct stat_state *state)	// prints the current sweep set and compares it with the previous one and with the current segment
+{
+	struct sweep_stats *sweep = &(state->current) ;
+	struct sweep_stats *previous = &(state->previous) ;
+	uint32_t nchannels = ( sweep->nalvl < INDEX_MAX_CHANNELS ) ? sweep->nalvl : INDEX_MAX_CHANNELS ;
+	double level = 0.0 ;					// the mean RMS of the channels in dB below full scale
+	double rms[INDEX_MAX_CHANNELS] ;
+	double peak[INDEX_MAX_CHANNELS] ;
+	struct sample_codec *codec = state->codec ;
+	for( uint32_t channel = 0 ; channel < nchannels ; channel++ )
+	{
+		struct power_sum *power = &(sweep->power[channel]) ;	// only one of the 16 bit and the wide totals is used
+		double squares = (double )power->sum_squares + power->wide_squares ;
+		rms[channel] = ( sweep->npairs[channel] > 0 ) ? sqrt(squares/sweep->npairs[channel]) : 0.0 ;	// the RMS magnitude of I + jQ
+		peak[channel] = ( -power->minimum > power->maximum ) ? -power->minimum : power->maximum ;
+		if( power->wide_peak > peak[channel] )
+			peak[channel] = power->wide_peak ;
+		level += 20.0*log10((rms[channel] + 1e-9)/codec->full_scale)/nchannels ;
+	}
+	if( state->list )
+	{
+		printf("sweep:%llu index:%u scal:%.17g,%.17g level:%.2f dB rms:",(unsigned long long )sweep->position,sweep->index,sweep->scalar_one,sweep->scalar_two,level) ;
+		for( uint32_t channel = 0 ; channel < nchannels ; channel++ )
+			printf(codec->floating ? "%s%.6g" : "%s%.1f",( channel == 0 ) ? "" : ",",rms[channel]) ;
+		printf(" peak:") ;
+		for( uint32_t channel = 0 ; channel < nchannels ; channel++ )
+			printf(codec->floating ? "%s%.6g" : "%s%.0f",( channel == 0 ) ? "" : ",",peak[channel]) ;
+		printf("\n") ;
+	}
+	int changed = 0 ;
+	if( sweep->position > 1 && (memcmp(&(sweep->scalar_one),&(previous->scalar_one),sizeof(double)) != 0 || memcmp(&(sweep->scalar_two),&(previous->scalar_two),sizeof(double)) != 0) )
+	{
+		printf("change:%llu index:%u scal:%.17g,%.17g -> %.17g,%.17g\n",(unsigned long long )sweep->position,sweep->index,
+			previous->scalar_one,previous->scalar_two,sweep->scalar_one,sweep->scalar_two) ;
+		changed = 1 ;
+	}
+	else if( state->threshold > 0 && state->segment_count > 0 )
+	{
+		double segment_level = state->segment_level/state->segment_count ;	// compare with the mean of the segment, one noisy sweep set moves it little
+		if( fabs(level - segment_level) >= state->threshold )
+		{
+			printf("change:%llu index:%u level:%.2f dB -> %.2f dB\n",(unsigned long long )sweep->position,sweep->index,segment_level,level) ;
+			changed = 1 ;
+		}
+	}
+	if( changed )
+	{
+		printf("segment:%llu-%llu\n",(unsigned long long )state->segment_start,(unsigned long long )sweep->position-1) ;
+		state->changes++ ;
+		state->segment_start = sweep->position ;
+		state->segment_level = 0.0 ;
+		state->segment_count = 0 ;
+	}
+	state->segment_level += level ;
+	state->segment_count++ ;
+	*previous = *sweep ;
+	return 0 ;
+}
+
+int tssplit(int argc, char *argv[])	// writes each run of sweep sets with the same configuration to its own binary file, with a copy of the header
+{
+	char *program_name = basename(argv[0]) ;
+	struct range_list starts ;		// positions that start a new file, given on the command line
+	memset(&starts,0,sizeof(struct range_list)) ;
+	int option ;
+	while( (option = getopt(argc,argv,"p:")) != -1 )
+	{
+		switch( option )
+		{
+			case 'p':
+				if( parse_ranges(optarg,&starts) ) return 1 ;
+			break ;
+			default:
+				usage_tssplit(program_name) ;
+				return 1 ;
+		}
+	}
+	if( optind >= argc )
+	{
+		usage_tssplit(program_name) ;
+		return 0 ;
+	}
+	char *infilename = argv[optind] ;
+	char *prefix = ( optind + 1 < argc ) ? strdup(argv[optind+1]) : strdup(infilename) ;	// output files are named prefix_1.ts, prefix_2.ts, ...
+	size_t length = strlen(prefix) ;
+	if( optind + 1 >= argc && length > 3 && strcmp(prefix+length-3,".ts") == 0 )
+		prefix[length-3] = '\0' ;
+	int fd = open(infilename,O_RDONLY) ;
+	if( fd < 0 )
+	{
+		printf("Cannot open input file '%s'\n",infilename) ;
+		free(prefix) ;
+		return 1 ;
+	}
+	struct sweep_index index ;
+	if( load_index(infilename,fd,&index) )
+	{
+		free(prefix) ;
+		close(fd) ;
+		return 1 ;
+	}
+	int err = 0 ;
+	if( index.header.body_offset == 0 || index.header.count == 0 )
+	{
+		printf("No sweep sets in '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	size_t head_size = err ? 0 : index.header.body_offset - sizeof(struct block_header) ;	// the blocks between the AQVL and BODY headers, none without BODY
+	unsigned char *head = malloc(head_size+1) ;
+	unsigned char *buffer = malloc(SIZE_COPY_BUFFER) ;
+	char *outfilename = malloc(strlen(prefix) + 32) ;
+	if( !err && (head == NULL || buffer == NULL || outfilename == NULL) )
+	{
+		printf("Cannot get memory to split '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	if( !err && pread(fd,head,head_size,sizeof(struct block_header)) != (ssize_t )head_size )
+	{
+		printf("Error reading the header of '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	uint64_t first = 0 ;
+	int files = 0 ;
+	for( uint64_t loop = 1 ; !err && loop <= index.header.count ; loop++ )
+	{
+		int split = ( loop == index.header.count ) ;		// the last sweep set always ends a file
+		if( !split )
+		{
+			struct index_entry *entry = &(index.entries[loop-1]) ;
+			struct index_entry *next = &(index.entries[loop]) ;
+			if( starts.count > 0 )
+				split = in_ranges(&starts,loop+1) ;
+			else
+				split = ( memcmp(&(entry->scalar_one),&(next->scalar_one),sizeof(double)) != 0 || memcmp(&(entry->scalar_two),&(next->scalar_two),sizeof(double)) != 0 ) ;
+		}
+		if( !split ) continue ;
+		sprintf(outfilename,"%s_%d.ts",prefix,++files) ;
+		err = write_segment(fd,&index,head,head_size,first,loop,outfilename,buffer) ;
+		if( !err )
+			printf("%s: sweep sets %llu-%llu\n",outfilename,(unsigned long long )first+1,(unsigned long long )loop) ;
+		first = loop ;
+	}
+	free(outfilename) ;
+	free(buffer) ;
+	free(head) ;
+	free(prefix) ;
+	free_index(&index) ;
+	free_ranges(&starts) ;
+	close(fd) ;
+	return err ;
+}
+
+void usage_tssplit(char *name)
+{
+	printf("Usage: %s [-p positions] infile [outprefix]\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Splits binary infile where the 'scal' values change, into outprefix_1.ts, outprefix_2.ts, ...\n") ;
+	printf("  -p  split before these sweep set positions instead, counted from 1, e.g. 101,150\n") ;
+}
+
+int write_segment(int fd, struct sweep_index *index, unsigned char *head, size_t head_size, uint64_t first, uint64_t last, char *outfilename, unsigned char *buffer)	// writes the header and sweep sets first to last-1 (counted from 0) to a new file
+{
+	uint64_t body_size = 0 ;
+	for( uint64_t loop = first ; loop < last ; loop++ )
+		body_size += index->entries[loop].length ;
+	set_head_nsweeps(head,head_size,last-first) ;
+	FILE *outfile = fopen(outfilename,"wb") ;
+	if( outfile == NULL )
+	{
+		printf("Cannot open output file '%s'\n",outfilename) ;
+		return 1 ;
+	}
+	uint64_t tail_size = index->header.file_size - index->header.end_offset ;	// normally just END, which lies outside AQVL
+	struct block_header aqlv ;
+	int err = ( pread(fd,&aqlv,sizeof(struct block_header),0) != sizeof(struct block_header) ) ;
+	endian_fixup(&(aqlv.size),sizeof(aqlv.size)) ;
+	uint64_t inside = aqlv.size + sizeof(struct block_header) - index->header.end_offset ;	// bytes of the tail that belong to AQVL
+	if( inside > tail_size ) inside = 0 ;
+	err = err
+		|| write_block_header(outfile,KEY_AQLV,head_size+sizeof(struct block_header)+body_size+inside)
+		|| fwrite(head,head_size,1,outfile) != 1
+		|| write_block_header(outfile,KEY_BODY,body_size)
+		|| copy_range(fd,index->entries[first].offset,body_size,outfile,buffer)
+		|| copy_range(fd,index->header.end_offset,tail_size,outfile,buffer) ;
+	if( fclose(outfile) != 0 ) err = 1 ;
+	if( err )
+	{
+		printf("Error writing output file '%s'\n",outfilename) ;
+		unlink(outfilename) ;		// a partial file would pass for a good one
+	}
+	return err ;
+}
+
+void set_head_nsweeps(unsigned char *head, size_t head_size, int32_t nsweeps)	// sets nsweeps in the cnst block of a copy of the blocks between the AQVL and BODY headers
+{
+	for( size_t offset = 0 ; offset + sizeof(struct block_header) <= head_size ; )
+	{
+		struct block_header header ;
+		memcpy(&header,head+offset,sizeof(struct block_header)) ;
+		endian_fixup(&(header.key),sizeof(header.key)) ;
+		endian_fixup(&(header.size),sizeof(header.size)) ;
+		if( header.key == KEY_HEAD )
+		{
+			offset += sizeof(struct block_header) ;	// step inside HEAD
+			continue ;
+		}
+		if( header.key == KEY_cnst && header.size >= sizeof(struct block_cnst) && offset + sizeof(struct block_header) + sizeof(struct block_cnst) <= head_size )
+		{
+			endian_fixup(&nsweeps,sizeof(nsweeps)) ;
+			memcpy(head+offset+sizeof(struct block_header)+offsetof(struct block_cnst,nsweeps),&nsweeps,sizeof(nsweeps)) ;
+			return ;
+		}
+		offset += sizeof(struct block_header) + header.size ;
+	}
+}
+
+#define PACK_MAGIC		"TSPACK\0\3"	// the last byte is the format version
+#define PACK_RAW		0		// alvl data stored as it is
+#define PACK_DELTA		1		// alvl data delta coded against the previous I or Q, zigzag coded and bit packed
+
+int tspack(int argc, char *argv[])	// writes a binary file as a packed file, the alvl samples compressed and everything else copied as it is
+{
+	char *program_name = basename(argv[0]) ;
+	if( argc != 3 )
+	{
+		usage_tspack(program_name) ;
+		return 0 ;
+	}
+	char *infilename = argv[1] ;
+	char *outfilename = argv[2] ;
+	int fd = open(infilename,O_RDONLY) ;
+	if( fd < 0 )
+	{
+		printf("Cannot open input file '%s'\n",infilename) ;
+		return 1 ;
+	}
+	struct stat in_stat ;
+	struct stat out_stat ;
+	if( fstat(fd,&in_stat) != 0 || !S_ISREG(in_stat.st_mode) )
+	{
+		printf("Cannot pack '%s', it is not a regular file\n",infilename) ;
+		close(fd) ;
+		return 1 ;
+	}
+	if( stat(outfilename,&out_stat) == 0 && in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino )
+	{
+		printf("The output file '%s' is the input file\n",outfilename) ;
+		close(fd) ;
+		return 1 ;
+	}
+	struct sweep_index index ;				// built rather than loaded, so no sidecar is left next to a file being archived
+	if( build_index(fd,&in_stat,&index) )
+	{
+		printf("Cannot read the blocks of '%s'\n",infilename) ;
+		free_index(&index) ;
+		close(fd) ;
+		return 1 ;
+	}
+	int err = 0 ;
+	if( index.header.body_offset == 0 )
+	{
+		printf("Cannot find the BODY block in '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	struct pack_header header ;
+	memset(&header,0,sizeof(struct pack_header)) ;
+	memcpy(header.magic,PACK_MAGIC,sizeof(header.magic)) ;
+	header.lanes = PACK_LANES ;
+	header.group = PACK_GROUP ;
+	header.file_size = in_stat.st_size ;
+	header.head_size = index.header.body_offset + sizeof(struct block_header) ;
+	header.count = index.header.count ;
+	header.sets_end = header.head_size ;
+	uint32_t largest = 0 ;
+	for( uint64_t loop = 0 ; loop < index.header.count ; loop++ )
+	{
+		struct index_entry *entry = &(index.entries[loop]) ;
+		header.sets_end = entry->offset + entry->length ;
+		if( entry->length > largest ) largest = entry->length ;
+	}
+	struct pack_entry *entries = malloc(index.header.count*sizeof(struct pack_entry)+1) ;
+	unsigned char *buffer = malloc(SIZE_COPY_BUFFER) ;
+	unsigned char *original = malloc((size_t )largest+1) ;
+	unsigned char *packed = malloc(2*(size_t )largest+1) ;	// a block header plus a pack_block is at most twice the bytes of the smallest block it packs
+	if( !err && (entries == NULL || buffer == NULL || original == NULL || packed == NULL) )
+	{
+		printf("Cannot get memory to pack '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	FILE *outfile = NULL ;
+	if( !err && (outfile = fopen(outfilename,"wb")) == NULL )
+	{
+		printf("Cannot open output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	struct pack_header file_header = header ;	// written again at the end with the table offset
+	pack_header_fixup(&file_header) ;
+	if( !err && fwrite(&file_header,sizeof(struct pack_header),1,outfile) != 1 )
+	{
+		printf("Error writing output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( !err )
+		err = copy_range(fd,0,header.head_size,outfile,buffer) ;
+	uint64_t position = sizeof(struct pack_header) + header.head_size ;
+	for( uint64_t loop = 0 ; !err && loop < index.header.count ; loop++ )
+	{
+		struct index_entry *entry = &(index.entries[loop]) ;
+		if( pread(fd,original,entry->length,entry->offset) != (ssize_t )entry->length )
+		{
+			printf("Error reading ts file at offset %llu\n",(unsigned long long )entry->offset) ;
+			err = 1 ;
+			break ;
+		}
+		size_t length = pack_sweep_set(original,entry->length,packed) ;
+		if( fwrite(packed,length,1,outfile) != 1 )
+		{
+			printf("Error writing %zu bytes\n",length) ;
+			err = 1 ;
+		}
+		entries[loop].offset = position ;
+		entries[loop].length = length ;
+		entries[loop].original_length = entry->length ;
+		entries[loop].index = entry->index ;
+		entries[loop].checksum = pack_checksum(original,entry->length) ;
+		position += length ;
+	}
+	if( !err )				// anything after the sweep sets, normally just END
+		err = copy_range(fd,header.sets_end,header.file_size-header.sets_end,outfile,buffer) ;
+	header.table_offset = position + header.file_size - header.sets_end ;
+	file_header = header ;
+	pack_header_fixup(&file_header) ;
+	if( !err )
+		pack_entry_fixup(entries,header.count) ;
+	if( !err && ((header.count > 0 && fwrite(entries,sizeof(struct pack_entry),header.count,outfile) != header.count)
+		|| fseek(outfile,0,SEEK_SET) != 0 || fwrite(&file_header,sizeof(struct pack_header),1,outfile) != 1) )
+	{
+		printf("Error writing the sweep set table\n") ;
+		err = 1 ;
+	}
+	if( outfile != NULL && fclose(outfile) != 0 && !err )
+	{
+		printf("Error writing output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( err && outfile != NULL )
+		unlink(outfilename) ;		// left behind, a partial file would pass for a good one
+	if( !err )
+	{
+		uint64_t total = header.table_offset + header.count*sizeof(struct pack_entry) ;
+		printf("Packed %llu sweep sets, %llu bytes into %llu (%.1f%%)\n",(unsigned long long )header.count,(unsigned long long )header.file_size,
+			(unsigned long long )total,( header.file_size > 0 ) ? 100.0*total/header.file_size : 100.0) ;
+	}
+	free(packed) ;
+	free(original) ;
+	free(buffer) ;
+	free(entries) ;
+	free_index(&index) ;
+	close(fd) ;
+	return err ;
+}
+
+void usage_tspack(char *name)
+{
+	printf("Usage: %s infile outfile\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Packs binary infile into outfile, compressing the 'alvl' samples, for tsunpack to restore exactly.\n") ;
+}
+
+int tsunpack(int argc, char *argv[])	// restores the binary file from a packed file, or only the selected sweep sets, reading only what they need
+{
+	char *program_name = basename(argv[0]) ;
+	struct range_list positions ;		// sweep sets to restore, counted from 1
+	struct range_list indexes ;		// sweep sets to restore, by indx value
+	memset(&positions,0,sizeof(struct range_list)) ;
+	memset(&indexes,0,sizeof(struct range_list)) ;
+	int list = 0 ;
+	int option ;
+	while( (option = getopt(argc,argv,"lp:x:")) != -1 )
+	{
+		switch( option )
+		{
+			case 'l':
+				list = 1 ;
+			break ;
+			case 'p':
+				if( parse_ranges(optarg,&positions) ) return 1 ;
+			break ;
+			case 'x':
+				if( parse_ranges(optarg,&indexes) ) return 1 ;
+			break ;
+			default:
+				usage_tsunpack(program_name) ;
+				return 1 ;
+		}
+	}
+	if( argc - optind < ( list ? 1 : 2 ) )
+	{
+		usage_tsunpack(program_name) ;
+		return 0 ;
+	}
+	char *infilename = argv[optind] ;
+	char *outfilename = argv[optind+1] ;
+	int fd = open(infilename,O_RDONLY) ;
+	if( fd < 0 )
+	{
+		printf("Cannot open input file '%s'\n",infilename) ;
+		return 1 ;
+	}
+	struct stat in_stat ;
+	struct pack_header header ;
+	int err = ( fstat(fd,&in_stat) != 0
+		|| pread(fd,&header,sizeof(struct pack_header),0) != sizeof(struct pack_header) ) ;
+	if( !err )
+		pack_header_fixup(&header) ;
+	err = ( err
+		|| memcmp(header.magic,PACK_MAGIC,sizeof(header.magic)) != 0
+		|| header.lanes != PACK_LANES
+		|| header.group != PACK_GROUP
+		|| header.head_size < 2*sizeof(struct block_header)
+		|| header.sets_end < header.head_size
+		|| header.file_size < header.sets_end
+		|| header.table_offset > (uint64_t )in_stat.st_size
+		|| header.count > ((uint64_t )in_stat.st_size - header.table_offset) / sizeof(struct pack_entry) ) ;
+	if( err )
+		printf("'%s' is not a packed file written by this version of tspack\n",infilename) ;
+	struct pack_entry *entries = NULL ;
+	if( !err && (entries = malloc(header.count*sizeof(struct pack_entry)+1)) == NULL )
+	{
+		printf("Cannot get memory for %llu sweep sets\n",(unsigned long long )header.count) ;
+		err = 1 ;
+	}
+	if( !err && pread(fd,entries,header.count*sizeof(struct pack_entry),header.table_offset) != (ssize_t )(header.count*sizeof(struct pack_entry)) )
+	{
+		printf("Error reading the sweep set table of '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	if( !err )
+		pack_entry_fixup(entries,header.count) ;
+	unsigned char *keep = calloc(header.count+1,1) ;	// 1 for each sweep set that is restored
+	uint64_t removed = 0 ;			// bytes of the sweep sets left out
+	uint64_t kept = 0 ;
+	uint64_t largest = 0 ;
+	uint64_t original_offset = header.head_size ;
+	for( uint64_t loop = 0 ; !err && loop < header.count ; loop++ )
+	{
+		struct pack_entry *entry = &(entries[loop]) ;
+		if( entry->offset > header.table_offset || entry->length > header.table_offset - entry->offset )
+		{
+			printf("Bad sweep set table in '%s'\n",infilename) ;
+			err = 1 ;
+			break ;
+		}
+		if( keep == NULL ) continue ;
+		keep[loop] = ( (positions.count == 0 && indexes.count == 0) || in_ranges(&positions,loop+1) || in_ranges(&indexes,entry->index) ) ;
+		if( list )
+			printf("sweep:%llu index:%u offset:%llu length:%u packed:%llu\n",(unsigned long long )loop+1,entry->index,
+				(unsigned long long )original_offset,entry->original_length,(unsigned long long )entry->length) ;
+		original_offset += entry->original_length ;
+		if( !keep[loop] )
+		{
+			removed += entry->original_length ;
+			continue ;
+		}
+		kept++ ;
+		if( entry->length > largest ) largest = entry->length ;
+		if( entry->original_length > largest ) largest = entry->original_length ;
+	}
+	if( list || err )
+	{
+		free(keep) ;
+		free(entries) ;
+		free_ranges(&positions) ;
+		free_ranges(&indexes) ;
+		close(fd) ;
+		return err ;
+	}
+	unsigned char *head = malloc(header.head_size) ;
+	unsigned char *buffer = malloc(SIZE_COPY_BUFFER) ;
+	unsigned char *packed = malloc(largest+1) ;
+	unsigned char *original = malloc(largest+1) ;
+	if( keep == NULL || head == NULL || buffer == NULL || packed == NULL || original == NULL )
+	{
+		printf("Cannot get memory to unpack '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	if( !err && pread(fd,head,header.head_size,sizeof(struct pack_header)) != (ssize_t )header.head_size )
+	{
+		printf("Error reading the header of '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	FILE *outfile = NULL ;
+	if( !err && (outfile = fopen(outfilename,"wb")) == NULL )
+	{
+		printf("Cannot open output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( !err )
+	{
+		struct block_header aqlv ;	// the AQVL and BODY sizes lose the sweep sets left out
+		struct block_header body ;
+		memcpy(&aqlv,head,sizeof(struct block_header)) ;
+		memcpy(&body,head+header.head_size-sizeof(struct block_header),sizeof(struct block_header)) ;
+		endian_fixup(&(aqlv.size),sizeof(aqlv.size)) ;
+		endian_fixup(&(body.size),sizeof(body.size)) ;
+		if( kept < header.count )	// and the cnst nsweeps becomes the number restored, as tsedit and tssplit do
+			set_head_nsweeps(head+sizeof(struct block_header),header.head_size-2*sizeof(struct block_header),kept) ;
+		err = write_block_header(outfile,KEY_AQLV,aqlv.size-removed)
+			|| fwrite(head+sizeof(struct block_header),header.head_size-2*sizeof(struct block_header),1,outfile) != 1
+			|| write_block_header(outfile,KEY_BODY,body.size-removed) ;
 	}
-}
-
-int dump_list(struct node *list, FILE *outfile, int just_header) // goes through the list of nodes, writing an ascii text description of each node to outfile
-{
-	unsigned int count = 0 ;
-	struct config config ;
-	memset(&config,0,sizeof(struct config)) ;
-	while( list != NULL )
+	for( uint64_t loop = 0 ; !err && loop < header.count ; loop++ )
 	{
-		//printf("debug: dump_list: node has key '%s'\n",strkey(list->key)) ;
-		struct block_functions *block_functions = find_block_functions(list->key) ;	// returns a set of functions from the Global_functions_dictionary for this block type
-		if( block_functions == NULL )
+		struct pack_entry *entry = &(entries[loop]) ;
+		if( !keep[loop] ) continue ;
+		if( pread(fd,packed,entry->length,entry->offset) != (ssize_t )entry->length )
 		{
-			printf("Cannot dump block '%s'\n",strkey(list->key)) ;
-			return 1 ;
+			printf("Error reading packed file at offset %llu\n",(unsigned long long )entry->offset) ;
+			err = 1 ;
 		}
-		int (*dump_function)(struct node *, struct config *, FILE *) = block_functions->dump ;
-		if( just_header && dump_function == dump_block_body ) return 0 ;
-		int err = (*dump_function)(list,&config,outfile) ;	// calls a function from the Global_function_dictionary corresponding to the block key
-		if( err )
+		else if( unpack_sweep_set(packed,entry->length,original,entry->original_length) || pack_checksum(original,entry->original_length) != entry->checksum )
 		{
-			printf("Error dumping block '%s'\n",strkey(list->key)) ;
-			return 1 ;
+			printf("Sweep set %llu of '%s' is damaged\n",(unsigned long long )loop+1,infilename) ;
+			err = 1 ;
+		}
+		else if( fwrite(original,entry->original_length,1,outfile) != 1 )
+		{
+			printf("Error writing %u bytes\n",entry->original_length) ;
+			err = 1 ;
 		}
-		list = list->next ;
 	}
-	return 0 ;
-}
-
-int fixup_data_aqlv(struct node *node)
-{
-	return 0 ;
+	uint64_t tail_size = header.file_size - header.sets_end ;	// copied in front of the table
+	if( !err && tail_size > header.table_offset )
+	{
+		printf("Bad sweep set table in '%s'\n",infilename) ;
+		err = 1 ;
+	}
+	if( !err )
+		err = copy_range(fd,header.table_offset-tail_size,tail_size,outfile,buffer) ;
+	if( outfile != NULL && fclose(outfile) != 0 && !err )
+	{
+		printf("Error writing output file '%s'\n",outfilename) ;
+		err = 1 ;
+	}
+	if( err && outfile != NULL )
+		unlink(outfilename) ;		// left behind, a partial file would pass for a good one
+	if( !err )
+		printf("Unpacked %llu of %llu sweep sets\n",(unsigned long long )kept,(unsigned long long )header.count) ;
+	free(original) ;
+	free(packed) ;
+	free(buffer) ;
+	free(head) ;
+	free(keep) ;
+	free(entries) ;
+	free_ranges(&positions) ;
+	free_ranges(&indexes) ;
+	close(fd) ;
+	return err ;
 }
 
-int dump_block_aqlv(struct node *node, struct config *config, FILE *outfile)
+void usage_tsunpack(char *name)
 {
-	fprintf(outfile,"%s\n",strkey(KEY_AQLV)) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	printf("Usage: %s [-l] [-p positions] [-x indexes] infile [outfile]\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Restores binary outfile from infile written by tspack.\n") ;
+	printf("  -l  list the sweep sets instead\n") ;
+	printf("  -p  restore only the sweep sets at these positions, counted from 1, e.g. 1-100,150\n") ;
+	printf("  -x  restore only the sweep sets with these indx values, e.g. 12-40\n") ;
+	printf("  with -p or -x the cnst nsweeps is set to the number of sweep sets restored\n") ;
 }
 
-int make_node_aqlv(struct node *list, struct config *config, FILE *fd)		// creates a new node for AQLV block, fd not used
+size_t pack_sweep_set(unsigned char *in, uint32_t length, unsigned char *out)	// copies the blocks of a sweep set with the alvl data packed, returns the bytes written to out
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	uint32_t offset = 0 ;
+	size_t packed = 0 ;
+	while( length - offset >= sizeof(struct block_header) )
 	{
-		printf("Malloc error\n") ;
-		return 1 ;
+		struct block_header header ;
+		memcpy(&header,in+offset,sizeof(struct block_header)) ;
+		endian_fixup(&(header.key),sizeof(header.key)) ;
+		endian_fixup(&(header.size),sizeof(header.size)) ;
+		if( header.size > length - offset - sizeof(struct block_header) )
+			break ;			// a truncated block is copied as it is, like anything else left over
+		memcpy(out+packed,in+offset,sizeof(struct block_header)) ;
+		offset += sizeof(struct block_header) ;
+		packed += sizeof(struct block_header) ;
+		if( header.key == KEY_alvl )
+		{
+			struct pack_block block ;
+			block.method = PACK_DELTA ;
+			block.length = pack_alvl(in+offset,header.size,out+packed+sizeof(struct pack_block)) ;
+			if( block.length == 0 )		// the samples do not compress
+			{
+				block.method = PACK_RAW ;
+				block.length = header.size ;
+				memcpy(out+packed+sizeof(struct pack_block),in+offset,header.size) ;
+			}
+			struct pack_block file_block = block ;	// big endian in the packed file
+			endian_fixup(&(file_block.method),sizeof(file_block.method)) ;
+			endian_fixup(&(file_block.length),sizeof(file_block.length)) ;
+			memcpy(out+packed,&file_block,sizeof(struct pack_block)) ;
+			packed += sizeof(struct pack_block) + block.length ;
+		}
+		else
+		{
+			memcpy(out+packed,in+offset,header.size) ;
+			packed += header.size ;
+		}
+		offset += header.size ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_AQLV ;
-	// fixup size at the very end
-	// no explicit data block, it's composed of sub blocks
-	return 0 ;
-}
-
-int gen_block_aqlv(struct node *node, FILE *outfile)
-{
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	memcpy(out+packed,in+offset,length-offset) ;
+	return packed + length - offset ;
 }
 
-int fixup_data_head(struct node *node)
+int unpack_sweep_set(unsigned char *in, uint64_t length, unsigned char *out, uint32_t original_length)	// undoes pack_sweep_set(), returns 1 if the packed data does not fit the original length
 {
+	uint64_t position = 0 ;
+	uint32_t offset = 0 ;
+	while( original_length - offset >= sizeof(struct block_header) )	// the same walk as pack_sweep_set(), over the blocks being restored
+	{
+		if( length - position < sizeof(struct block_header) )
+			return 1 ;
+		struct block_header header ;
+		memcpy(&header,in+position,sizeof(struct block_header)) ;
+		endian_fixup(&(header.key),sizeof(header.key)) ;
+		endian_fixup(&(header.size),sizeof(header.size)) ;
+		if( header.size > original_length - offset - sizeof(struct block_header) )
+			break ;
+		memcpy(out+offset,in+position,sizeof(struct block_header)) ;
+		position += sizeof(struct block_header) ;
+		offset += sizeof(struct block_header) ;
+		struct pack_block block = { PACK_RAW, header.size } ;
+		if( header.key == KEY_alvl )
+		{
+			if( length - position < sizeof(struct pack_block) )
+				return 1 ;
+			memcpy(&block,in+position,sizeof(struct pack_block)) ;
+			endian_fixup(&(block.method),sizeof(block.method)) ;
+			endian_fixup(&(block.length),sizeof(block.length)) ;
+			position += sizeof(struct pack_block) ;
+		}
+		if( block.length > length - position )
+			return 1 ;
+		if( block.method == PACK_RAW && block.length == header.size )
+			memcpy(out+offset,in+position,header.size) ;
+		else if( block.method != PACK_DELTA || unpack_alvl(in+position,block.length,out+offset,header.size) )
+			return 1 ;
+		position += block.length ;
+		offset += header.size ;
+	}
+	if( length - position != original_length - offset )
+		return 1 ;
+	memcpy(out+offset,in+position,original_length-offset) ;
 	return 0 ;
 }
 
-int dump_block_head(struct node *node, struct config *config, FILE *outfile)
+uint32_t pack_alvl(unsigned char *in, uint32_t size, unsigned char *out)	// packs the big endian samples of an alvl block, returns the packed size, or 0 if it would not be smaller
 {
-	fprintf(outfile,"%s\n",strkey(KEY_HEAD)) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	if( size % (2*sizeof(int16_t)) != 0 )
+		return 0 ;		// not whole I/Q pairs
+	size_t count = size / sizeof(int16_t) ;
+	size_t groups = (count + PACK_GROUP - 1) / PACK_GROUP ;
+	size_t widths = (groups + 15) & ~(size_t )15 ;		// a byte per group, padded so the packed groups stay 16 byte aligned
+	uint16_t zigzag[PACK_GROUP] ;
+	uint16_t previous[2] = { 0, 0 } ;			// the last I and Q
+	size_t packed = widths ;
+	for( size_t group = 0 ; group < groups ; group++ )	// find the widths first, to give up before writing more than size bytes
+	{
+		if( packed >= size )
+			return 0 ;
+		out[group] = zigzag_group(in+group*PACK_GROUP*sizeof(int16_t),count-group*PACK_GROUP,previous,zigzag) ;
+		packed += out[group] * PACK_GROUP / 8 ;
+	}
+	if( packed >= size )
+		return 0 ;
+	memset(out+groups,0,widths-groups) ;
+	previous[0] = 0 ;
+	previous[1] = 0 ;
+	unsigned char *next = out + widths ;
+	for( size_t group = 0 ; group < groups ; group++ )
+	{
+		zigzag_group(in+group*PACK_GROUP*sizeof(int16_t),count-group*PACK_GROUP,previous,zigzag) ;
+		pack_group(zigzag,out[group],next) ;
+		next += out[group] * PACK_GROUP / 8 ;
+	}
+	return packed ;
 }
 
-int make_node_head(struct node *list, struct config *config, FILE *fd)
+int unpack_alvl(unsigned char *in, uint32_t length, unsigned char *out, uint32_t size)	// undoes pack_alvl(), writing size bytes of big endian samples, returns 1 if the packed data is damaged
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
-	{
-		printf("Malloc error\n") ;
+	if( size % (2*sizeof(int16_t)) != 0 )
 		return 1 ;
+	size_t count = size / sizeof(int16_t) ;
+	size_t groups = (count + PACK_GROUP - 1) / PACK_GROUP ;
+	size_t widths = (groups + 15) & ~(size_t )15 ;
+	if( length < widths )
+		return 1 ;
+	void (*unpack16)(const unsigned char *, int, uint16_t *, unsigned char *, size_t) = swap_kernel()->unpack16 ;
+	uint16_t previous[2] = { 0, 0 } ;
+	size_t position = widths ;
+	for( size_t group = 0 ; group < groups ; group++ )
+	{
+		int width = in[group] ;
+		if( width > 16 || length - position < (size_t )width * PACK_GROUP / 8 )
+			return 1 ;
+		size_t values = count - group*PACK_GROUP ;
+		(*unpack16)(in+position,width,previous,out+group*PACK_GROUP*sizeof(int16_t),( values < PACK_GROUP ) ? values : PACK_GROUP) ;
+		position += width * PACK_GROUP / 8 ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_HEAD ;
-	// fixup size at the very end
-	// no explicit data block, it's composed of sub blocks
-	return 0 ;
+	return ( position != length ) ;
 }
 
-int gen_block_head(struct node *node, FILE *outfile)
+int zigzag_group(unsigned char *in, size_t count, uint16_t *previous, uint16_t *zigzag)	// codes up to PACK_GROUP samples as the zigzag of their difference from the previous I or Q, returns the bits needed
 {
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	uint16_t bits = 0 ;
+	for( size_t loop = 0 ; loop < PACK_GROUP ; loop += 2 )
+	{
+		uint16_t i = 0 ;		// the difference, 0 past the end of the block
+		uint16_t q = 0 ;
+		if( loop < count )
+		{
+			uint16_t value_i = in[2*loop] << 8 | in[2*loop+1] ;
+			uint16_t value_q = in[2*loop+2] << 8 | in[2*loop+3] ;
+			i = value_i - previous[0] ;
+			q = value_q - previous[1] ;
+			previous[0] = value_i ;
+			previous[1] = value_q ;
+		}
+		zigzag[loop] = (uint16_t )(i << 1) ^ (uint16_t )(0 - (i >> 15)) ;	// small differences of either sign become small numbers
+		zigzag[loop+1] = (uint16_t )(q << 1) ^ (uint16_t )(0 - (q >> 15)) ;
+		bits |= zigzag[loop] | zigzag[loop+1] ;
+	}
+	int width = 0 ;
+	while( width < 16 && (bits >> width) != 0 )
+		width++ ;
+	return width ;
 }
 
-
-struct block_sign				// contains only the data portion for this type of block, i.e. no header data (key, size)
-{
-	fourcc version ;			// file version
-	fourcc filetype ;			// file type
-	fourcc sitecode ; 			// site code
-	uint32_t userflags ;			// user flags
-	char description[SIZE_DESCRIPTION] ;	// file description
-	char ownername[SIZE_OWNERNAME] ;	// owner name
-	char comment[SIZE_COMMENT] ;		// comment
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_sign(struct node *node)
+void unzigzag_group(uint16_t *zigzag, size_t count, uint16_t *previous, unsigned char *out)	// undoes zigzag_group() for count samples, writing them big endian
 {
-	if( node->size < sizeof(struct block_sign) )
+	uint16_t i = previous[0] ;
+	uint16_t q = previous[1] ;
+	for( size_t loop = 0 ; loop < count ; loop += 2 )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_sign)) ;
-		return 1 ;
+		i += (zigzag[loop] >> 1) ^ (uint16_t )(0 - (zigzag[loop] & 1)) ;
+		q += (zigzag[loop+1] >> 1) ^ (uint16_t )(0 - (zigzag[loop+1] & 1)) ;
+		out[2*loop] = i >> 8 ;
+		out[2*loop+1] = i ;
+		out[2*loop+2] = q >> 8 ;
+		out[2*loop+3] = q ;
 	}
-	struct block_sign *sign = (struct block_sign *)(node->data) ;
-	endian_fixup(&(sign->version),sizeof(sign->version)) ;
-	endian_fixup(&(sign->filetype),sizeof(sign->filetype)) ;
-	endian_fixup(&(sign->sitecode),sizeof(sign->sitecode)) ;
-	endian_fixup(&(sign->userflags),sizeof(sign->userflags)) ;
-	return 0 ;
+	previous[0] = i ;
+	previous[1] = q ;
 }
 
-int dump_block_sign(struct node *node, struct config *config, FILE *outfile)
+void pack_group(uint16_t *zigzag, int width, unsigned char *out)	// packs PACK_GROUP values of width bits into width*16 bytes, each lane a stream of 16 values
 {
-	if( node->size < sizeof(struct block_sign) )
+	uint16_t words[PACK_GROUP] ;		// row r of the lanes holds bits 16r to 16r+15 of each lane's stream
+	memset(words,0,sizeof(words)) ;
+	for( int row = 0 ; row < PACK_GROUP/PACK_LANES ; row++ )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_sign)) ;
-		return 1 ;
+		int bit = row * width ;
+		int shift = bit % 16 ;
+		uint16_t *word = words + (bit/16)*PACK_LANES ;
+		uint16_t *value = zigzag + row*PACK_LANES ;
+		for( int lane = 0 ; lane < PACK_LANES ; lane++ )
+			word[lane] |= value[lane] << shift ;
+		if( shift + width > 16 )	// the value straddles two words
+		{
+			for( int lane = 0 ; lane < PACK_LANES ; lane++ )
+				word[PACK_LANES+lane] |= value[lane] >> (16 - shift) ;
+		}
 	}
-	struct block_sign *sign = (struct block_sign *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_sign)) ;
-	fprintf(outfile,"version:%s\n",strkey(sign->version)) ;
-	fprintf(outfile,"filetype:%s\n",strkey(sign->filetype)) ;
-	fprintf(outfile,"sitecode:%s\n",strkey(sign->sitecode)) ;
-	fprintf(outfile,"userflags:%x\n",sign->userflags) ;
-	fprintf(outfile,"description:%.*s\n",SIZE_DESCRIPTION,sign->description) ;
-	fprintf(outfile,"ownername:%.*s\n",SIZE_OWNERNAME,sign->ownername) ;
-	fprintf(outfile,"comment:%.*s\n",SIZE_OWNERNAME,sign->comment) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	if( HOST_LITTLE_ENDIAN )
+		swap16_scalar(words,width*PACK_LANES) ;	// the lane words are big endian
+	memcpy(out,words,width*PACK_LANES*sizeof(uint16_t)) ;
 }
 
-int make_node_sign(struct node *list, struct config *config, FILE *fd)
+uint64_t pack_checksum(const unsigned char *data, size_t length)	// Fletcher style sums of the big endian 32 bit words in 4 independent lanes, to find damage that still unpacks
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	uint64_t sum[4] = { 0, 0, 0, 0 } ;
+	uint64_t sums[4] = { 0, 0, 0, 0 } ;
+	size_t loop = 0 ;
+	uint32_t words[SIZE_GEN_CHUNK] ;		// swapped to host order a chunk at a time with the swap kernel, then summed as plain words
+	void (*swap32)(void *, size_t) = swap_kernel()->swap32 ;
+	while( length - loop >= 4*sizeof(uint32_t) )
 	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
+		size_t bytes = (length - loop) & ~(4*sizeof(uint32_t) - 1) ;	// whole groups of the 4 lanes
+		if( bytes > sizeof(words) ) bytes = sizeof(words) ;
+		memcpy(words,data+loop,bytes) ;
+		if( HOST_LITTLE_ENDIAN )
+			(*swap32)(words,bytes/sizeof(uint32_t)) ;
+		for( size_t word = 0 ; word < bytes/sizeof(uint32_t) ; word += 4 )
+		{
+			for( int lane = 0 ; lane < 4 ; lane++ )
+			{
+				sum[lane] += words[word+lane] ;
+				sums[lane] += sum[lane] ;
+			}
+		}
+		loop += bytes ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_sign ;
-	struct block_sign *sign = malloc(sizeof(struct block_sign)) ;
-	if( sign == NULL )
+	for( ; loop < length ; loop++ )		// the odd bytes at the end
 	{
-		printf("Malloc error on data block\n") ;
-		return 1 ;
+		sum[0] += data[loop] ;
+		sums[0] += sum[0] ;
 	}
-	memset(sign,0,sizeof(struct block_sign)) ;
-	newnode->data = (unsigned char *)sign ;
-	newnode->size = sizeof(struct block_sign) ;
-	if( read_parameter(fd,"version:%4c",(void *)&(sign->version)) ) return 1 ;
-	if( read_parameter(fd,"filetype:%4c",(void *)&(sign->filetype)) ) return 1 ;
-	if( read_parameter(fd,"sitecode:%4c",(void *)&(sign->sitecode)) ) return 1 ;
-	if( read_parameter(fd,"userflags:%x",(void *)&(sign->userflags)) ) return 1 ;
-	char format[32] ;
-	sprintf(format,"description:%%%dc",SIZE_DESCRIPTION) ;
-	if( read_parameter(fd,format,(void *)(sign->description)) ) return 1 ;
-	sprintf(format,"ownername:%%%dc",SIZE_OWNERNAME) ;
-	if( read_parameter(fd,format,(void *)(sign->ownername)) ) return 1 ;
-	sprintf(format,"comment:%%%dc",SIZE_COMMENT) ;
-	if( read_parameter(fd,format,(void *)(sign->comment)) ) return 1 ;
-	return 0 ;
+	uint64_t checksum = 0 ;
+	for( int lane = 0 ; lane < 4 ; lane++ )
+		checksum = (checksum << 13 | checksum >> 51) ^ sum[lane] ^ (sums[lane] << 32 | sums[lane] >> 32) ;
+	return checksum ;
 }
 
-int gen_block_sign(struct node *node, FILE *outfile)
+void pack_header_fixup(struct pack_header *header)	// swaps the fields between host order and the big endian of the packed file, either way
 {
-	struct block_sign *sign = (struct block_sign *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	//endian_fixup(&(sign->version),sizeof(sign->version)) ;
-	if( fwrite(&(sign->version),sizeof(sign->version),1,outfile) != 1 ) return 1 ;
-	//endian_fixup(&(sign->filetype),sizeof(sign->filetype)) ;
-	if( fwrite(&(sign->filetype),sizeof(sign->filetype),1,outfile) != 1 ) return 1 ;
-	//endian_fixup(&(sign->sitecode),sizeof(sign->sitecode)) ;
-	if( fwrite(&(sign->sitecode),sizeof(sign->sitecode),1,outfile) != 1 ) return 1 ;
-	//endian_fixup(&(sign->userflags),sizeof(sign->userflags)) ;
-	if( fwrite(&(sign->userflags),sizeof(sign->userflags),1,outfile) != 1 ) return 1 ;
-	if( fwrite(&(sign->description),SIZE_DESCRIPTION,1,outfile) != 1 ) return 1 ;
-	if( fwrite(&(sign->ownername),SIZE_OWNERNAME,1,outfile) != 1 ) return 1 ;
-	if( fwrite(&(sign->comment),SIZE_COMMENT,1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	endian_fixup(&(header->lanes),sizeof(header->lanes)) ;
+	endian_fixup(&(header->group),sizeof(header->group)) ;
+	endian_fixup(&(header->file_size),sizeof(header->file_size)) ;
+	endian_fixup(&(header->head_size),sizeof(header->head_size)) ;
+	endian_fixup(&(header->sets_end),sizeof(header->sets_end)) ;
+	endian_fixup(&(header->count),sizeof(header->count)) ;
+	endian_fixup(&(header->table_offset),sizeof(header->table_offset)) ;
 }
 
-
-struct block_mcda
-{
-	uint32_t timestamp ;		// mac timestamp of first sweep
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_mcda(struct node *node)
+void pack_entry_fixup(struct pack_entry *entries, size_t count)	// the same for the sweep set table
 {
-	if( node->size < sizeof(struct block_mcda) )
+	for( size_t loop = 0 ; loop < count ; loop++ )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_mcda)) ;
-		return 1 ;
+		endian_fixup(&(entries[loop].offset),sizeof(entries[loop].offset)) ;
+		endian_fixup(&(entries[loop].length),sizeof(entries[loop].length)) ;
+		endian_fixup(&(entries[loop].original_length),sizeof(entries[loop].original_length)) ;
+		endian_fixup(&(entries[loop].index),sizeof(entries[loop].index)) ;
+		endian_fixup(&(entries[loop].checksum),sizeof(entries[loop].checksum)) ;
 	}
-	struct block_mcda *mcda = (struct block_mcda *)(node->data) ;
-	endian_fixup(&(mcda->timestamp),sizeof(mcda->timestamp)) ;
-	return 0 ;
 }
 
-int dump_block_mcda(struct node *node, struct config *config, FILE *outfile)
+void unpack_group(const unsigned char *in, int width, uint16_t *zigzag)	// undoes pack_group()
 {
-	if( node->size < sizeof(struct block_mcda) )
+	if( width == 0 )			// every difference was 0
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_mcda)) ;
-		return 1 ;
+		memset(zigzag,0,PACK_GROUP*sizeof(uint16_t)) ;
+		return ;
 	}
-	struct block_mcda *mcda = (struct block_mcda *)(node->data) ;
-	uint32_t mcda_time = mcda->timestamp ;
-	time_t t = mcda_time ;
-	fprintf(outfile,"%s\n",strkey(KEY_mcda)) ;
-	if( t != 0 )
+	uint16_t words[PACK_GROUP] ;
+	memcpy(words,in,width*PACK_LANES*sizeof(uint16_t)) ;
+	if( HOST_LITTLE_ENDIAN )
+		swap16_scalar(words,width*PACK_LANES) ;
+	uint16_t mask = (1u << width) - 1 ;
+	for( int row = 0 ; row < PACK_GROUP/PACK_LANES ; row++ )
 	{
-		t -= 2082844800 ;	// move epoc from 1904-01-01 00:00:00 to 1970-01-01 00:00:00 
-		fprintf(outfile,"timestamp:%lu (NB: seconds since 1970) (%.24s)\n",t,ctime(&t)) ;
+		int bit = row * width ;
+		int shift = bit % 16 ;
+		uint16_t *word = words + (bit/16)*PACK_LANES ;
+		uint16_t *value = zigzag + row*PACK_LANES ;
+		for( int lane = 0 ; lane < PACK_LANES ; lane++ )
+			value[lane] = (word[lane] >> shift) & mask ;
+		if( shift + width > 16 )
+		{
+			for( int lane = 0 ; lane < PACK_LANES ; lane++ )
+				value[lane] |= (word[PACK_LANES+lane] << (16 - shift)) & mask ;
+		}
 	}
-	fprintf(outfile,"\n") ;
-	return 0 ;
 }
 
-int make_node_mcda(struct node *list, struct config *config, FILE *fd)		// creates a new node for mcda block
+#define EXPORT_SUFFIX_NPY	".npy"
+#define EXPORT_SUFFIX_JSON	".json"
+#define NPY_ALIGN		64		// numpy pads its headers so the array data starts on this boundary
+
+int tsexport(int argc, char *argv[])	// writes the alvl samples of a binary file as one NumPy array, with the header fields in a JSON sidecar
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	char *program_name = basename(argv[0]) ;
+	struct export_options options ;
+	memset(&options,0,sizeof(struct export_options)) ;
+	int option ;
+	while( (option = getopt(argc,argv,"a:fpr:x:")) != -1 )
 	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
+		switch( option )
+		{
+			case 'a':
+				if( parse_ranges(optarg,&(options.channels)) ) return 1 ;
+			break ;
+			case 'f':
+				options.scaled = 1 ;
+			break ;
+			case 'p':
+				options.planar = 1 ;
+			break ;
+			case 'r':
+				if( parse_ranges(optarg,&(options.sweeps)) ) return 1 ;
+			break ;
+			case 'x':
+				if( parse_ranges(optarg,&(options.indexes)) ) return 1 ;
+			break ;
+			default:
+				usage_tsexport(program_name) ;
+				return 1 ;
+		}
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_mcda ;
-	struct block_mcda *mcda = malloc(sizeof(struct block_mcda)) ;
-	if( mcda == NULL )
+	if( optind >= argc )
 	{
-		printf("Malloc error on data block\n") ;
+		usage_tsexport(program_name) ;
+		return 0 ;
+	}
+	options.infilename = argv[optind] ;
+	char *prefix = ( optind + 1 < argc ) ? strdup(argv[optind+1]) : strdup(options.infilename) ;	// the output files are prefix.npy and prefix.json
+	size_t length = strlen(prefix) ;
+	if( optind + 1 >= argc && length > 3 && strcmp(prefix+length-3,".ts") == 0 )
+		prefix[length-3] = '\0' ;
+	options.npyname = malloc(strlen(prefix) + sizeof(EXPORT_SUFFIX_NPY)) ;
+	char *jsonname = malloc(strlen(prefix) + sizeof(EXPORT_SUFFIX_JSON)) ;
+	if( options.npyname == NULL || jsonname == NULL )
+	{
+		printf("Malloc error on output file names\n") ;
+		free(options.npyname) ;
+		free(jsonname) ;
+		free(prefix) ;
 		return 1 ;
 	}
-	memset(mcda,0,sizeof(struct block_mcda)) ;
-	newnode->data = (unsigned char *)mcda ;
-	newnode->size = sizeof(struct block_mcda) ;
-	if( read_parameter(fd,"timestamp:%u",(void *)&(mcda->timestamp)) ) return 1 ;
-	mcda->timestamp += 2082844800 ;	// move epoc from 1970-01-01 00:00:00 to 1904-01-01 00:00:00 
-	return 0 ;
+	sprintf(options.npyname,"%s%s",prefix,EXPORT_SUFFIX_NPY) ;
+	sprintf(jsonname,"%s%s",prefix,EXPORT_SUFFIX_JSON) ;
+	free(prefix) ;
+	int err = 0 ;
+	struct ts_file *file = ts_open(options.infilename) ;
+	if( file == NULL )
+		err = 1 ;
+	else if( (options.codec = find_sample_codec(file_bin_type(file))) == NULL )
+	{
+		printf("Unknown bin_type '%s' (%x)\n",strkey(file_bin_type(file)),file_bin_type(file)) ;
+		err = 1 ;
+	}
+	size_t nsweeps = ( file != NULL ) ? ts_sweep_count(file) : 0 ;
+	options.positions = malloc(nsweeps*sizeof(size_t)+1) ;
+	if( !err && options.positions == NULL )
+	{
+		printf("Cannot get memory for %zu sweep sets\n",nsweeps) ;
+		err = 1 ;
+	}
+	for( size_t position = 0 ; !err && position < nsweeps ; position++ )	// find the selected sweep sets and check they all have the same shape
+	{
+		struct ts_sweep sweep ;
+		if( ts_get_sweep(file,position,&sweep) )
+		{
+			err = 1 ;
+			break ;
+		}
+		if( options.sweeps.count > 0 && !in_ranges(&(options.sweeps),position+1) ) continue ;
+		if( options.indexes.count > 0 && !in_ranges(&(options.indexes),sweep.index) ) continue ;
+		size_t nchannels = 0 ;
+		size_t nsamples = 0 ;
+		for( int channel = 0 ; channel < sweep.nchannels ; channel++ )
+		{
+			if( options.channels.count > 0 && !in_ranges(&(options.channels),channel+1) ) continue ;
+			if( nchannels > 0 && sweep.channel[channel].count != nsamples )
+				nsamples = 0 ;		// the channels differ, reported below
+			else
+				nsamples = sweep.channel[channel].count ;
+			nchannels++ ;
+		}
+		if( options.count == 0 )
+		{
+			options.nchannels = nchannels ;
+			options.nsamples = nsamples ;
+		}
+		if( nchannels != options.nchannels || nsamples != options.nsamples || nsamples == 0 )
+		{
+			printf("Sweep set %zu does not have %zu channels of %zu samples like the first one exported, an array needs the same shape throughout\n",
+				position+1,options.nchannels,options.nsamples) ;
+			err = 1 ;
+			break ;
+		}
+		options.positions[options.count++] = position ;
+	}
+	if( !err && options.count == 0 )
+	{
+		printf("No sweep sets selected, the file has %zu\n",nsweeps) ;
+		err = 1 ;
+	}
+	if( !err )
+		err = write_export_array(file,&options) ;
+	if( !err )
+		err = write_export_sidecar(file,&options,jsonname) ;
+	if( !err )
+		printf("%s: %zu sweep sets of %zu channels of %zu samples\n",options.npyname,options.count,options.nchannels,options.nsamples) ;
+	if( file != NULL )
+		ts_close(file) ;
+	free(options.positions) ;
+	free(options.npyname) ;
+	free(jsonname) ;
+	free_ranges(&(options.channels)) ;
+	free_ranges(&(options.sweeps)) ;
+	free_ranges(&(options.indexes)) ;
+	return err ;
 }
 
-int gen_block_mcda(struct node *node, FILE *outfile)
+void usage_tsexport(char *name)
 {
-	struct block_mcda *mcda = (struct block_mcda *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(mcda->timestamp),sizeof(mcda->timestamp)) ;
-	if( fwrite(&(mcda->timestamp),sizeof(mcda->timestamp),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	printf("Usage: %s [-a channels] [-f] [-p] [-r positions] [-x indexes] infile [outprefix]\n",name) ;
+	printf("Processes CODAR SeaSonde TimeSeries data files.\n") ;
+	printf("Writes the 'alvl' samples of binary infile as a NumPy array [sweep, channel, sample] in outprefix.npy,\n") ;
+	printf("and the header fields in outprefix.json. outprefix defaults to infile without '.ts'.\n") ;
+	printf("  -a  export only these channels, counted from 1 within each sweep set, e.g. 1,3\n") ;
+	printf("  -f  export complex64 samples scaled like tsdump writes them, instead of the I/Q counts\n") ;
+	printf("      (the counts are int16 for fix2 files, int32 for fix3 and fix4, float32 for flt4)\n") ;
+	printf("  -p  planar: all I values of an 'alvl' block, then all Q values, giving [sweep, channel, 2, sample]\n") ;
+	printf("  -r  export only the sweep sets at these positions, counted from 1, e.g. 1-10,50\n") ;
+	printf("  -x  export only the sweep sets with these indx values, e.g. 12-40\n") ;
 }
 
-
-struct block_cnst
-{
-	int32_t nchannels ;		// number of antennas/channels (normally 3)
-	int32_t nsweeps ;		// number of sweeps (normally 32)
-	int32_t nsamples ;		// number of samples (normally 2048)
-	int32_t iqindicator ;		// iqindicator: 1=?, 2=IQ
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_cnst(struct node *node)
+int write_export_array(struct ts_file *file, struct export_options *options)	// writes the .npy file, the samples converted one alvl block at a time
 {
-	if( node->size < sizeof(struct block_cnst) )
+	struct sample_codec *codec = options->codec ;
+	size_t shape[4] = { options->count, options->nchannels, options->nsamples, 2 } ;	// interleaved counts end in the I/Q pair
+	if( options->planar )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_cnst)) ;
+		shape[2] = 2 ;
+		shape[3] = options->nsamples ;
+	}
+	char *descr = options->planar ? "f4" : "c8" ;	// complex64 is a pair of float32
+	if( !options->scaled )
+		descr = codec->dtype ;
+	int ndims = ( options->scaled && !options->planar ) ? 3 : 4 ;
+	size_t value_size = ( options->scaled || codec->width > 2 ) ? sizeof(float) : sizeof(int16_t) ;	// fix3 counts are widened to int32
+	size_t size = 2*options->nsamples*value_size ;	// bytes of one channel
+	void *buffer = malloc(size) ;
+	double *values = malloc(2*options->nsamples*sizeof(double)) ;
+	if( buffer == NULL || values == NULL )
+	{
+		printf("Cannot get memory for %zu bytes of samples\n",size) ;
+		free(buffer) ;
+		free(values) ;
 		return 1 ;
 	}
-	struct block_cnst *cnst = (struct block_cnst *)node->data ;
-	endian_fixup(&(cnst->nchannels),sizeof(cnst->nchannels)) ;
-	endian_fixup(&(cnst->nsweeps),sizeof(cnst->nchannels)) ;
-	endian_fixup(&(cnst->nsamples),sizeof(cnst->nsamples)) ;
-	endian_fixup(&(cnst->iqindicator),sizeof(cnst->iqindicator)) ;
-	return 0 ;
+	FILE *outfile = fopen(options->npyname,"wb") ;
+	if( outfile == NULL )
+	{
+		printf("Cannot open output file '%s'\n",options->npyname) ;
+		free(buffer) ;
+		free(values) ;
+		return 1 ;
+	}
+	int err = write_npy_header(outfile,descr,shape,ndims) ;
+	for( size_t loop = 0 ; !err && loop < options->count ; loop++ )
+	{
+		struct ts_sweep sweep ;
+		if( (err = ts_get_sweep(file,options->positions[loop],&sweep)) != 0 )
+			break ;
+		for( int channel = 0 ; !err && channel < sweep.nchannels ; channel++ )
+		{
+			if( options->channels.count > 0 && !in_ranges(&(options->channels),channel+1) ) continue ;
+			size_t count = sweep.channel[channel].count ;
+			const void *data = buffer ;
+			if( !options->scaled && !options->planar && (size_t )codec->width == value_size )
+				data = sweep.channel[channel].data ;	// already interleaved and in host order
+			else
+			{
+				(*codec->load)(sweep.channel[channel].data,2*count,values) ;
+				size_t step = options->planar ? 1 : 2 ;
+				size_t offset_q = options->planar ? count : 1 ;
+				for( size_t sample = 0 ; sample < count ; sample++ )
+				{
+					double i = values[2*sample] ;
+					double q = values[2*sample+1] ;
+					if( options->scaled )	// the same arithmetic as dump_block_alvl()
+					{
+						i = i/codec->factor*sweep.scalar_one ;
+						q = q/codec->factor*sweep.scalar_two ;
+					}
+					if( value_size == sizeof(int16_t) )
+					{
+						((int16_t *)buffer)[sample*step] = i ;
+						((int16_t *)buffer)[sample*step+offset_q] = q ;
+					}
+					else if( options->scaled || codec->floating )
+					{
+						((float *)buffer)[sample*step] = i ;
+						((float *)buffer)[sample*step+offset_q] = q ;
+					}
+					else
+					{
+						((int32_t *)buffer)[sample*step] = i ;
+						((int32_t *)buffer)[sample*step+offset_q] = q ;
+					}
+				}
+			}
+			if( fwrite(data,size,1,outfile) != 1 )
+			{
+				printf("Error writing %zu bytes\n",size) ;
+				err = 1 ;
+			}
+		}
+	}
+	if( fclose(outfile) != 0 && !err )
+	{
+		printf("Error writing output file '%s'\n",options->npyname) ;
+		err = 1 ;
+	}
+	free(buffer) ;
+	free(values) ;
+	return err ;
 }
 
-int dump_block_cnst(struct node *node, struct config *config, FILE *outfile)
+int write_npy_header(FILE *outfile, char *descr, size_t *shape, int ndims)	// writes a version 1.0 .npy header for a C order array in host byte order
 {
-	if( node->size < sizeof(struct block_cnst) )
+	char dict[256] ;
+	int used = sprintf(dict,"{'descr': '%c%s', 'fortran_order': False, 'shape': (",HOST_LITTLE_ENDIAN ? '<' : '>',descr) ;
+	for( int dim = 0 ; dim < ndims ; dim++ )
+		used += sprintf(dict+used,"%s%zu",dim ? ", " : "",shape[dim]) ;
+	used += sprintf(dict+used,"), }") ;
+	size_t length = 10 + used + 1 ;			// the magic, version and length, the dict and a newline
+	size_t padding = (NPY_ALIGN - length % NPY_ALIGN) % NPY_ALIGN ;	// so the data can be mapped straight into an array
+	memset(dict+used,' ',padding) ;
+	used += padding ;
+	dict[used++] = '\n' ;
+	unsigned char preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, used & 0xff, used >> 8 } ;	// the header length is little endian
+	if( fwrite(preamble,sizeof(preamble),1,outfile) != 1 || fwrite(dict,used,1,outfile) != 1 )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_cnst)) ;
+		printf("Error writing the .npy header\n") ;
 		return 1 ;
 	}
-	struct block_cnst *cnst = (struct block_cnst *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_cnst)) ;
-	fprintf(outfile,"nchannels:%d\n",cnst->nchannels) ;
-	fprintf(outfile,"nsweeps:%d\n",cnst->nsweeps) ;
-	fprintf(outfile,"nsamples:%d\n",cnst->nsamples) ;
-	fprintf(outfile,"iqindicator:%d\n",cnst->iqindicator) ;
-	fprintf(outfile,"\n") ;
 	return 0 ;
 }
 
-int make_node_cnst(struct node *list, struct config *config, FILE *fd)		// creates a new node for cnst block
+int write_export_sidecar(struct ts_file *file, struct export_options *options, char *jsonname)	// writes the header fields and the per sweep set values as JSON
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	FILE *outfile = fopen(jsonname,"w") ;
+	if( outfile == NULL )
 	{
-		printf("Malloc error on list node\n") ;
+		printf("Cannot open output file '%s'\n",jsonname) ;
 		return 1 ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_cnst ;
-	struct block_cnst *cnst = malloc(sizeof(struct block_cnst)) ;
-	if( cnst == NULL )
+	fprintf(outfile,"{\n  \"source\": ") ;
+	write_json_string(outfile,options->infilename) ;
+	fprintf(outfile,",\n  \"array\": ") ;
+	write_json_string(outfile,options->npyname) ;
+	char *dtype = options->codec->floating ? "float32" : ( options->codec->width == 2 ) ? "int16" : "int32" ;
+	if( options->scaled )
+		dtype = options->planar ? "float32" : "complex64" ;
+	fprintf(outfile,",\n  \"dtype\": \"%s\",\n",dtype) ;
+	fprintf(outfile,"  \"layout\": \"%s\",\n",options->planar ? "planar" : "interleaved") ;
+	fprintf(outfile,"  \"scaled\": %s,\n",options->scaled ? "true" : "false") ;
+	fprintf(outfile,"  \"shape\": [%zu, %zu",options->count,options->nchannels) ;
+	if( options->planar )
+		fprintf(outfile,", 2, %zu],\n",options->nsamples) ;
+	else
+		fprintf(outfile,options->scaled ? ", %zu],\n" : ", %zu, 2],\n",options->nsamples) ;
+	fprintf(outfile,"  \"channels\": [") ;
+	struct ts_sweep sweep ;
+	int err = ts_get_sweep(file,options->positions[0],&sweep) ;
+	for( int channel = 0, listed = 0 ; !err && channel < sweep.nchannels ; channel++ )
 	{
-		printf("Malloc error on data block\n") ;
-		return 1 ;
+		if( options->channels.count > 0 && !in_ranges(&(options->channels),channel+1) ) continue ;
+		fprintf(outfile,"%s%d",listed++ ? ", " : "",channel+1) ;
 	}
-	memset(cnst,0,sizeof(struct block_cnst)) ;
-	newnode->data = (unsigned char *)cnst ;
-	newnode->size = sizeof(struct block_cnst) ;
-	if( read_parameter(fd,"nchannels:%d",(void *)&(cnst->nchannels)) ) return 1 ;
-	if( read_parameter(fd,"nsweeps:%d",(void *)&(cnst->nsweeps)) ) return 1 ;
-	if( read_parameter(fd,"nsamples:%d",(void *)&(cnst->nsamples)) ) return 1 ;
-	if( read_parameter(fd,"iqindicator:%d",(void *)&(cnst->iqindicator)) ) return 1 ;
-	return 0 ;
+	fprintf(outfile,"],\n") ;
+	struct ts_sign sign ;
+	if( ts_get_sign(file,&sign) == 0 )
+	{
+		fprintf(outfile,"  \"sign\": { \"version\": ") ;
+		write_json_string(outfile,sign.version) ;
+		fprintf(outfile,", \"filetype\": ") ;
+		write_json_string(outfile,sign.filetype) ;
+		fprintf(outfile,", \"sitecode\": ") ;
+		write_json_string(outfile,sign.sitecode) ;
+		fprintf(outfile,", \"userflags\": %u, \"description\": ",sign.userflags) ;
+		write_json_string(outfile,sign.description) ;
+		fprintf(outfile,", \"ownername\": ") ;
+		write_json_string(outfile,sign.ownername) ;
+		fprintf(outfile,", \"comment\": ") ;
+		write_json_string(outfile,sign.comment) ;
+		fprintf(outfile," },\n") ;
+	}
+	struct node *mcda = find_head_block(file,KEY_mcda) ;
+	if( mcda != NULL )
+	{
+		long long timestamp = ((struct block_mcda *)(mcda->data))->timestamp ;
+		if( timestamp != 0 )
+			timestamp -= 2082844800 ;	// seconds since 1970 like tsdump shows, not since 1904
+		fprintf(outfile,"  \"mcda\": { \"timestamp\": %lld },\n",timestamp) ;
+	}
+	struct ts_cnst cnst ;
+	if( ts_get_cnst(file,&cnst) == 0 )
+		fprintf(outfile,"  \"cnst\": { \"nchannels\": %d, \"nsweeps\": %d, \"nsamples\": %d, \"iqindicator\": %d },\n",
+			cnst.nchannels,cnst.nsweeps,cnst.nsamples,cnst.iqindicator) ;
+	struct ts_swep swep ;
+	if( ts_get_swep(file,&swep) == 0 )
+		fprintf(outfile,"  \"swep\": { \"samplespersweep\": %d, \"sweepstart\": %.17g, \"sweepbandwidth\": %.17g, \"sweeprate\": %.17g, \"rangeoffset\": %d },\n",
+			swep.samplespersweep,swep.sweepstart,swep.sweepbandwidth,swep.sweeprate,swep.rangeoffset) ;
+	struct ts_fbin fbin ;
+	if( ts_get_fbin(file,&fbin) == 0 )
+	{
+		fprintf(outfile,"  \"fbin\": { \"format\": ") ;
+		write_json_string(outfile,fbin.format) ;
+		fprintf(outfile,", \"type\": ") ;
+		write_json_string(outfile,fbin.type) ;
+		fprintf(outfile," },\n") ;
+	}
+	char *names[] = { "position", "index", "gtag", "atag", "scalar_one", "scalar_two" } ;	// one array per sweep set value, in the order of the array's first axis
+	int nnames = sizeof(names)/sizeof(names[0]) ;
+	fprintf(outfile,"  \"sweeps\": {\n") ;
+	for( int name = 0 ; !err && name < nnames ; name++ )
+	{
+		fprintf(outfile,"    \"%s\": [",names[name]) ;
+		for( size_t loop = 0 ; !err && loop < options->count ; loop++ )
+		{
+			if( (err = ts_get_sweep(file,options->positions[loop],&sweep)) != 0 )
+				break ;
+			fprintf(outfile,"%s",loop ? ", " : "") ;
+			switch( name )
+			{
+				case 0: fprintf(outfile,"%zu",options->positions[loop]+1) ; break ;
+				case 1: fprintf(outfile,"%u",sweep.index) ; break ;
+				case 2: fprintf(outfile,"%u",sweep.gtag) ; break ;
+				case 3: fprintf(outfile,"%u",sweep.atag) ; break ;
+				case 4: fprintf(outfile,"%.17g",sweep.scalar_one) ; break ;
+				case 5: fprintf(outfile,"%.17g",sweep.scalar_two) ; break ;
+			}
+		}
+		fprintf(outfile,"]%s\n",( name+1 < nnames ) ? "," : "") ;
+	}
+	fprintf(outfile,"  }\n}\n") ;
+	if( fclose(outfile) != 0 && !err )
+	{
+		printf("Error writing output file '%s'\n",jsonname) ;
+		err = 1 ;
+	}
+	return err ;
 }
 
-int gen_block_cnst(struct node *node, FILE *outfile)
+void write_json_string(FILE *outfile, const char *text)	// writes text as a quoted JSON string
 {
-	struct block_cnst *cnst = (struct block_cnst *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(cnst->nchannels),sizeof(cnst->nchannels)) ;
-	if( fwrite(&(cnst->nchannels),sizeof(cnst->nchannels),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(cnst->nsweeps),sizeof(cnst->nsweeps)) ;
-	if( fwrite(&(cnst->nsweeps),sizeof(cnst->nsweeps),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(cnst->nsamples),sizeof(cnst->nsamples)) ;
-	if( fwrite(&(cnst->nsamples),sizeof(cnst->nsamples),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(cnst->iqindicator),sizeof(cnst->iqindicator)) ;
-	if( fwrite(&(cnst->iqindicator),sizeof(cnst->iqindicator),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	fputc('"',outfile) ;
+	for( const unsigned char *next = (const unsigned char *)text ; *next != '\0' ; next++ )
+	{
+		if( *next == '"' || *next == '\\' )
+			fprintf(outfile,"\\%c",*next) ;
+		else if( *next < 0x20 || *next >= 0x7f )	// control characters, and bytes that may not be valid UTF-8
+			fprintf(outfile,"\\u%04x",*next) ;
+		else
+			fputc(*next,outfile) ;
+	}
+	fputc('"',outfile) ;
 }
 
+#define BENCH_MEGABYTES	64
+#define BENCH_REPEAT	16
+#define BENCH_CHANNELS		3		// the defaults of tsbench -p, a typical SeaSonde file
+#define BENCH_SWEEP_SETS	100
+#define BENCH_SAMPLES		2048
+#define BENCH_PHASE_REPEAT	3
 
-struct block_swep
-{
-	int32_t samplespersweep ;	// number of samples per sweep/channels (normally 2048)
-	double sweepstart ;		// sweep start frequency in Hertz
-	double sweepbandwidth ;		// sweep bandwidth in Hertz
-	double sweeprate ;		// sweep rate in Hertz
-	int32_t rangeoffset ;		// rangeoffset (not used)
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_swep(struct node *node)
+int tsbench(int argc, char *argv[])	// times the byte swap kernels, or with -p the conversion phases of a synthetic file
 {
-	if( node->size < sizeof(struct block_swep) )
+	char *program_name = basename(argv[0]) ;
+	struct bench_params params ;
+	memset(&params,0,sizeof(struct bench_params)) ;
+	params.channels = BENCH_CHANNELS ;
+	params.sweep_sets = BENCH_SWEEP_SETS ;
+	params.samples = BENCH_SAMPLES ;
+	params.bin_type = BINTYPE_FIX2 ;
+	params.repeat = BENCH_PHASE_REPEAT ;
+	int pipeline = 0 ;
+	char *jsonname = NULL ;
+	int option ;
+	while( (option = getopt(argc,argv,"a:cn:o:pr:s:t:w:")) != -1 )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_swep)) ;
-		return 1 ;
+		switch( option )
+		{
+			case 'a':
+				params.channels = atoi(optarg) ;
+			break ;
+			case 'c':
+				params.compact = 1 ;
+			break ;
+			case 'n':
+				params.sweep_sets = atoi(optarg) ;
+			break ;
+			case 'o':
+				jsonname = optarg ;
+			break ;
+			case 'p':
+				pipeline = 1 ;
+			break ;
+			case 'r':
+				params.repeat = atoi(optarg) ;
+			break ;
+			case 's':
+				params.samples = atoi(optarg) ;
+			break ;
+			case 'w':
+				params.filename = optarg ;
+			break ;
+			case 't':
+				if( strlen(optarg) != sizeof(fourcc) )
+				{
+					usage_tsbench(program_name) ;
+					return 1 ;
+				}
+				memcpy(&(params.bin_type),optarg,sizeof(fourcc)) ;
+				endian_fixup(&(params.bin_type),sizeof(fourcc)) ;
+			break ;
+			default:
+				usage_tsbench(program_name) ;
+				return 1 ;
+		}
 	}
-	struct block_swep *swep = (struct block_swep *)(node->data) ;
-	endian_fixup(&(swep->samplespersweep),sizeof(swep->samplespersweep)) ;
-	endian_fixup(&(swep->sweepstart),sizeof(swep->sweepstart)) ;
-	endian_fixup(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth)) ;
-	endian_fixup(&(swep->sweeprate),sizeof(swep->sweeprate)) ;
-	endian_fixup(&(swep->rangeoffset),sizeof(swep->rangeoffset)) ;
-	return 0 ;
-}
-
-int dump_block_swep(struct node *node, struct config *config, FILE *outfile)
-{
-	if( node->size < sizeof(struct block_swep) )
+	if( !pipeline )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_swep)) ;
-		return 1 ;
+		size_t megabytes = BENCH_MEGABYTES ;
+		if( optind < argc )
+			megabytes = strtoul(argv[optind],NULL,10) ;
+		if( megabytes == 0 )
+		{
+			usage_tsbench(program_name) ;
+			return 1 ;
+		}
+		return bench_kernels(megabytes) ;
 	}
-	struct block_swep *swep = (struct block_swep *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_swep)) ;
-	fprintf(outfile,"samplespersweep:%d\n",swep->samplespersweep) ;
-	fprintf(outfile,"sweepstart:%.20lf\n",swep->sweepstart) ;
-	fprintf(outfile,"sweepbandwidth:%.20lf\n",swep->sweepbandwidth) ;
-	fprintf(outfile,"sweeprate:%.20lf\n",swep->sweeprate) ;
-	fprintf(outfile,"rangeoffset:%d\n",swep->rangeoffset) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
-}
-
-int make_node_swep(struct node *list, struct config *config, FILE *fd)		// creates a new node for swep block
-{
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	if( params.channels < 1 || params.sweep_sets < 1 || params.samples < 1 || params.repeat < 1 )
 	{
-		printf("Malloc error on list node\n") ;
+		usage_tsbench(program_name) ;
 		return 1 ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_swep ;
-	struct block_swep *swep = malloc(sizeof(struct block_swep)) ;
-	if( swep == NULL )
+	FILE *report = stdout ;
+	if( jsonname != NULL && (report = fopen(jsonname,"w")) == NULL )
 	{
-		printf("Malloc error on data block\n") ;
+		printf("Cannot open output file '%s'\n",jsonname) ;
 		return 1 ;
 	}
-	memset(swep,0,sizeof(struct block_swep)) ;
-	newnode->data = (unsigned char *)swep ;
-	newnode->size = sizeof(struct block_swep) ;
-	if( read_parameter(fd,"samplespersweep:%d",(void *)&(swep->samplespersweep)) ) return 1 ;
-	if( read_parameter(fd,"sweepstart:%lf",(void *)&(swep->sweepstart)) ) return 1 ;
-	if( read_parameter(fd,"sweepbandwidth:%lf",(void *)&(swep->sweepbandwidth)) ) return 1 ;
-	if( read_parameter(fd,"sweeprate:%lf",(void *)&(swep->sweeprate)) ) return 1 ;
-	if( read_parameter(fd,"rangeoffset:%d",(void *)&(swep->rangeoffset)) ) return 1 ;
-	return 0 ;
+	int err = bench_pipeline(&params,report) ;
+	if( report != stdout )
+		fclose(report) ;
+	return err ;
 }
 
-int gen_block_swep(struct node *node, FILE *outfile)
+void usage_tsbench(char *name)
 {
-	struct block_swep *swep = (struct block_swep *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(swep->samplespersweep),sizeof(swep->samplespersweep)) ;
-	if( fwrite(&(swep->samplespersweep),sizeof(swep->samplespersweep),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(swep->sweepstart),sizeof(swep->sweepstart)) ;
-	if( fwrite(&(swep->sweepstart),sizeof(swep->sweepstart),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth)) ;
-	if( fwrite(&(swep->sweepbandwidth),sizeof(swep->sweepbandwidth),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(swep->sweeprate),sizeof(swep->sweeprate)) ;
-	if( fwrite(&(swep->sweeprate),sizeof(swep->sweeprate),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(swep->rangeoffset),sizeof(swep->rangeoffset)) ;
-	if( fwrite(&(swep->rangeoffset),sizeof(swep->rangeoffset),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	printf("Usage: %s [megabytes]\n",name) ;
+	printf("       %s -p [-a channels] [-c] [-n sweep_sets] [-o json_file] [-r repeat] [-s samples] [-t bin_type] [-w binary_file]\n",name) ;
+	printf("Times the byte swap and power kernels on a buffer of megabytes, default %d.\n",BENCH_MEGABYTES) ;
+	printf("With -p, makes a synthetic binary file and times converting it, reporting JSON.\n") ;
+	printf("  -a  alvl blocks per sweep set, default %d\n",BENCH_CHANNELS) ;
+	printf("  -c  dump the text in the compact form of tsdump -c\n") ;
+	printf("  -n  sweep sets, default %d\n",BENCH_SWEEP_SETS) ;
+	printf("  -o  write the report to json_file instead of stdout\n") ;
+	printf("  -r  runs of each phase, the fastest is reported, default %d\n",BENCH_PHASE_REPEAT) ;
+	printf("  -s  I/Q samples per alvl block, default %d\n",BENCH_SAMPLES) ;
+	printf("  -t  fbin type, fix2 (default), fix3, fix4 or flt4\n") ;
+	printf("  -w  also write the synthetic file to binary_file\n") ;
 }
 
-
-struct block_fbin
-{
-	fourcc bin_format ;	// format (normally 'cviq')
-	fourcc bin_type ;	// type of ALVL data ('flt4','fix4','fix3','fix2')
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_fbin(struct node *node)
+int bench_kernels(size_t megabytes)	// times each byte swap kernel this cpu supports and reports GB/s
 {
-	if( node->size < sizeof(struct block_fbin) )
+	size_t size = megabytes*1024*1024 ;
+	unsigned char *data = malloc(size) ;
+	unsigned char *check = malloc(size) ;
+	if( data == NULL || check == NULL )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_fbin)) ;
+		printf("Cannot get memory for %zu MB benchmark buffer\n",megabytes) ;
+		free(data) ;
+		free(check) ;
 		return 1 ;
 	}
-	struct block_fbin *fbin = (struct block_fbin *)node->data ;
-	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;
-	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;
-	return 0 ;
-}
-
-int dump_block_fbin(struct node *node, struct config *config, FILE *outfile)
-{
-	if( node->size < sizeof(struct block_fbin) )
+	for( size_t loop = 0 ; loop < size ; loop++ )
+		data[loop] = loop*7 + (loop >> 9) ;
+	printf("selected kernel: %s\n",swap_kernel()->name) ;
+	int err = 0 ;
+	for( int width = 16 ; width <= 32 ; width += 8 )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_fbin)) ;
-		return 1 ;
+		memcpy(check,data,size) ;		// the scalar kernel provides the reference result
+		if( width == 16 )
+			swap16_scalar(check,size/2) ;
+		else if( width == 24 )
+			swap24_scalar(check,size/3) ;
+		else
+			swap32_scalar(check,size/4) ;
+		for( struct swap_kernel *kernel = Global_swap_kernels ; kernel->name != NULL ; kernel++ )
+		{
+			if( !(*kernel->supported)() )
+			{
+				printf("swap%d %-8s not supported\n",width,kernel->name) ;
+				continue ;
+			}
+			void (*swap)(void *, size_t) = ( width == 16 ) ? kernel->swap16 : ( width == 24 ) ? kernel->swap24 : kernel->swap32 ;
+			size_t count = size/(width/8) ;
+			(*swap)(data,count) ;		// warm up, then check against the reference
+			int correct = ( memcmp(data,check,size) == 0 ) ;
+			(*swap)(data,count) ;		// swap back
+			double start = bench_seconds() ;
+			for( int repeat = 0 ; repeat < BENCH_REPEAT ; repeat++ )
+				(*swap)(data,count) ;
+			double seconds = bench_seconds() - start ;
+			printf("swap%d %-8s %8.2f GB/s%s\n",width,kernel->name,(double )size*BENCH_REPEAT/seconds/1e9,correct ? "" : " WRONG RESULT") ;
+			if( !correct ) err = 1 ;
+		}
 	}
-	struct block_fbin *fbin = (struct block_fbin *)(node->data) ;
-	config->bin_type = fbin->bin_type ;	// remember this for alvl blocks
-	fprintf(outfile,"%s\n",strkey(KEY_fbin)) ;
-	fprintf(outfile,"format:%s\n",strkey(fbin->bin_format)) ;
-	fprintf(outfile,"type:%s\n",strkey(fbin->bin_type)) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	struct power_sum reference ;
+	memset(&reference,0,sizeof(struct power_sum)) ;
+	power16_scalar(data,size/2,&reference) ;
+	for( struct swap_kernel *kernel = Global_swap_kernels ; kernel->name != NULL ; kernel++ )
+	{
+		if( !(*kernel->supported)() )
+		{
+			printf("power16 %-8s not supported\n",kernel->name) ;
+			continue ;
+		}
+		struct power_sum sum ;
+		memset(&sum,0,sizeof(struct power_sum)) ;
+		(*kernel->power16)(data,size/2,&sum) ;
+		int correct = ( memcmp(&sum,&reference,sizeof(struct power_sum)) == 0 ) ;
+		double start = bench_seconds() ;
+		for( int repeat = 0 ; repeat < BENCH_REPEAT ; repeat++ )
+			(*kernel->power16)(data,size/2,&sum) ;
+		double seconds = bench_seconds() - start ;
+		printf("power16 %-8s %8.2f GB/s%s\n",kernel->name,(double )size*BENCH_REPEAT/seconds/1e9,correct ? "" : " WRONG RESULT") ;
+		if( !correct ) err = 1 ;
+	}
+	size_t groups = size / (PACK_GROUP*sizeof(int16_t)) ;	// pack the buffer at every width in turn, the widths tspack uses
+	unsigned char *packed = malloc(groups*PACK_GROUP*sizeof(int16_t)) ;
+	if( packed == NULL )
+		groups = 0 ;
+	for( size_t group = 0 ; group < groups ; group++ )
+	{
+		int width = group % 17 ;
+		uint16_t zigzag[PACK_GROUP] ;
+		memcpy(zigzag,data+group*sizeof(zigzag),sizeof(zigzag)) ;
+		for( int loop = 0 ; loop < PACK_GROUP ; loop++ )
+			zigzag[loop] &= (1u << width) - 1 ;
+		pack_group(zigzag,width,packed+group*sizeof(zigzag)) ;
+	}
+	uint16_t previous[2] = { 0, 0 } ;	// the scalar kernel provides the reference result
+	for( size_t group = 0 ; group < groups ; group++ )
+		unpack16_scalar(packed+group*PACK_GROUP*sizeof(int16_t),group % 17,previous,check+group*PACK_GROUP*sizeof(int16_t),PACK_GROUP) ;
+	for( struct swap_kernel *kernel = Global_swap_kernels ; groups > 0 && kernel->name != NULL ; kernel++ )
+	{
+		if( !(*kernel->supported)() )
+		{
+			printf("unpack16 %-7s not supported\n",kernel->name) ;
+			continue ;
+		}
+		double start = 0 ;
+		for( int repeat = 0 ; repeat <= BENCH_REPEAT ; repeat++ )	// the first run is the warm up
+		{
+			previous[0] = 0 ;
+			previous[1] = 0 ;
+			for( size_t group = 0 ; group < groups ; group++ )
+				(*kernel->unpack16)(packed+group*PACK_GROUP*sizeof(int16_t),group % 17,previous,data+group*PACK_GROUP*sizeof(int16_t),PACK_GROUP) ;
+			if( repeat == 0 )
+				start = bench_seconds() ;
+		}
+		double seconds = bench_seconds() - start ;
+		int correct = ( memcmp(data,check,groups*PACK_GROUP*sizeof(int16_t)) == 0 ) ;
+		printf("unpack16 %-7s %8.2f GB/s%s\n",kernel->name,(double )groups*PACK_GROUP*sizeof(int16_t)*BENCH_REPEAT/seconds/1e9,correct ? "" : " WRONG RESULT") ;
+		if( !correct ) err = 1 ;
+	}
+	free(packed) ;
+	free(data) ;
+	free(check) ;
+	return err ;
 }
 
-int make_node_fbin(struct node *list, struct config *config, FILE *fd)		// creates a new node for fbin block
+int bench_pipeline(struct bench_params *params, FILE *report)	// times each conversion phase of a synthetic file and reports them as JSON
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	struct parse_context context ;
+	init_context(&context) ;
+	struct node root ;
+	memset(&root,0,sizeof(struct node)) ;
+	char *binary = NULL ;					// the synthetic file
+	size_t binary_size = 0 ;
+	double seconds = bench_seconds() ;
+	int err = make_synthetic(params,&context,&root) ;
+	if( !err )
 	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
+		FILE *outfile = open_memstream(&binary,&binary_size) ;
+		err = ( outfile == NULL || ts_write(root.next,outfile) ) ;
+		if( outfile != NULL )
+			fclose(outfile) ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_fbin ;
-	struct block_fbin *fbin = malloc(sizeof(struct block_fbin)) ;
-	if( fbin == NULL )
+	double generate = bench_seconds() - seconds ;
+	release_context(&context) ;
+	if( err )
 	{
-		printf("Malloc error on data block\n") ;
+		printf("Cannot make the synthetic file\n") ;
+		free(binary) ;
 		return 1 ;
 	}
-	memset(fbin,0,sizeof(struct block_fbin)) ;
-	newnode->data = (unsigned char *)fbin ;
-	newnode->size = sizeof(struct block_fbin) ;
-	char format[16] ;
-	sprintf(format,"format:%%%lus",sizeof(fbin->bin_format)) ;
-	if( read_parameter(fd,format,(void *)&(fbin->bin_format)) ) return 1 ;	// read as a 4 byte string
-	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;		// then endian correct to 4 bytes int
-	sprintf(format,"type:%%%lus",sizeof(fbin->bin_type)) ;
-	if( read_parameter(fd,format,(void *)&(fbin->bin_type)) ) return 1 ;	// read as a 4 byte string
-	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;		// then endian correct to 4 bytes int
-	config->bin_type = fbin->bin_type ;	// remember this for alvl blocks
-	//printf("debug: make_node_fbin: fbin->bin_type=%s\n",strkey(fbin->bin_type)) ;
-	return 0 ;
-}
-
-int gen_block_fbin(struct node *node, FILE *outfile)
-{
-	struct block_fbin *fbin = (struct block_fbin *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(fbin->bin_format),sizeof(fbin->bin_format)) ;
-	if( fwrite(&(fbin->bin_format),sizeof(fbin->bin_format),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(fbin->bin_type),sizeof(fbin->bin_type)) ;
-	if( fwrite(&(fbin->bin_type),sizeof(fbin->bin_type),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	if( params->filename != NULL )
+	{
+		FILE *outfile = fopen(params->filename,"wb") ;
+		if( outfile == NULL || fwrite(binary,1,binary_size,outfile) != binary_size )
+		{
+			printf("Cannot write file '%s'\n",params->filename) ;
+			err = 1 ;
+		}
+		if( outfile != NULL && fclose(outfile) != 0 )
+			err = 1 ;
+		if( err )
+		{
+			free(binary) ;
+			return 1 ;
+		}
+	}
+	double best[5] = { 0, 0, 0, 0, 0 } ;			// parse, fixup, dump, text parse, write
+	unsigned char *copy = malloc(binary_size) ;
+	char *text = NULL ;
+	size_t text_size = 0 ;
+	int verified = 1 ;
+	for( int run = 0 ; !err && run < params->repeat ; run++ )
+	{
+		double phase[5] ;
+		memcpy(copy,binary,binary_size) ;		// the parser fixes up in place, so each run starts from the file bytes
+		init_context(&context) ;
+		seconds = bench_seconds() ;
+		struct node *list = parse_file(&context,copy,binary_size) ;
+		phase[0] = bench_seconds() - seconds ;
+		err = ( list == NULL ) ;
+		if( !err )
+		{
+			struct config config ;			// the fbin block is in file order half the time, so the bin_type is given
+			memset(&config,0,sizeof(struct config)) ;
+			config.bin_type = params->bin_type ;
+			fixup_list(list,&config) ;		// back to file order, timed, then to host order again, untimed
+			seconds = bench_seconds() ;
+			fixup_list(list,&config) ;
+			phase[1] = bench_seconds() - seconds ;
+			struct dump_options options ;
+			memset(&options,0,sizeof(struct dump_options)) ;
+			options.compact = params->compact ;
+			options.threads = 1 ;
+			free(text) ;
+			text = NULL ;
+			FILE *outfile = open_memstream(&text,&text_size) ;
+			seconds = bench_seconds() ;
+			err = ( outfile == NULL || dump_list(list,outfile,&options) ) ;
+			if( outfile != NULL )
+				fclose(outfile) ;
+			phase[2] = bench_seconds() - seconds ;
+		}
+		release_context(&context) ;
+		if( !err )
+		{
+			init_context(&context) ;
+			memset(&root,0,sizeof(struct node)) ;
+			FILE *infile = fmemopen(text,text_size,"r") ;
+			seconds = bench_seconds() ;
+			err = ( infile == NULL || read_text_list(infile,&context,&root) ) ;
+			phase[3] = bench_seconds() - seconds ;
+			if( infile != NULL )
+				fclose(infile) ;
+			char *written = NULL ;
+			size_t written_size = 0 ;
+			FILE *outfile = open_memstream(&written,&written_size) ;
+			seconds = bench_seconds() ;
+			err = err || ( outfile == NULL || fixup_sizes(&root) || ts_write(root.next,outfile) ) ;
+			if( outfile != NULL )
+				fclose(outfile) ;
+			phase[4] = bench_seconds() - seconds ;
+			if( !err && (written_size != binary_size || memcmp(written,binary,binary_size) != 0) )
+				verified = 0 ;			// the round trip must give back the same file
+			free(written) ;
+			release_context(&context) ;
+		}
+		for( int loop = 0 ; !err && loop < 5 ; loop++ )
+			if( run == 0 || phase[loop] < best[loop] )
+				best[loop] = phase[loop] ;
+	}
+	if( !err )
+	{
+		double samples = (double )params->sweep_sets * params->channels * params->samples ;
+		fprintf(report,"{\n") ;
+		fprintf(report,"  \"channels\": %d,\n",params->channels) ;
+		fprintf(report,"  \"sweep_sets\": %d,\n",params->sweep_sets) ;
+		fprintf(report,"  \"samples\": %d,\n",params->samples) ;
+		fprintf(report,"  \"bin_type\": \"%s\",\n",strkey(params->bin_type)) ;
+		fprintf(report,"  \"compact\": %d,\n",params->compact) ;
+		fprintf(report,"  \"repeat\": %d,\n",params->repeat) ;
+		fprintf(report,"  \"kernel\": \"%s\",\n",swap_kernel()->name) ;
+		fprintf(report,"  \"binary_bytes\": %zu,\n",binary_size) ;
+		fprintf(report,"  \"text_bytes\": %zu,\n",text_size) ;
+		fprintf(report,"  \"verified\": %s,\n",verified ? "true" : "false") ;
+		fprintf(report,"  \"phases\": [\n") ;
+		report_phase(report,"generate",generate,binary_size,samples,0) ;
+		report_phase(report,"parse",best[0],binary_size,samples,0) ;
+		report_phase(report,"fixup",best[1],binary_size,samples,0) ;
+		report_phase(report,"dump",best[2],text_size,samples,0) ;
+		report_phase(report,"text_parse",best[3],text_size,samples,0) ;
+		report_phase(report,"write",best[4],binary_size,samples,1) ;
+		fprintf(report,"  ]\n") ;
+		fprintf(report,"}\n") ;
+	}
+	if( !verified )
+		printf("The binary file written back differs from the synthetic file\n") ;
+	free(copy) ;
+	free(text) ;
+	free(binary) ;
+	return err || !verified ;
 }
 
-
-int fixup_data_body(struct node *node)
+void report_phase(FILE *report, char *name, double seconds, double bytes, double samples, int last)	// one element of the phases array, bytes are those of the phase's output or input, whichever is text
 {
-	return 0 ;
+	fprintf(report,"    { \"name\": \"%s\", \"seconds\": %.6f, \"mb_per_s\": %.1f, \"samples_per_s\": %.0f }%s\n",
+		name,seconds,bytes/seconds/1e6,samples/seconds,last ? "" : ",") ;
 }
 
-int dump_block_body(struct node *node, struct config *config, FILE *outfile)
+void fixup_list(struct node *list, struct config *config)	// fixes up the data of every block again, which swaps it between file and host order
 {
-	fprintf(outfile,"%s\n",strkey(KEY_BODY)) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	for( ; list != NULL ; list = list->next )
+		if( !superblock(list->key) )
+			fixup_data(list,config) ;
 }
 
-int make_node_body(struct node *list, struct config *config, FILE *fd)		// creates a new node for body block
+int make_synthetic(struct bench_params *params, struct parse_context *context, struct node *root)	// makes the node list of a valid file, with pseudo random samples
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	struct sample_codec *codec = find_sample_codec(params->bin_type) ;
+	if( codec == NULL )
 	{
-		printf("Malloc error\n") ;
+		printf("Unknown bin_type '%s'\n",strkey(params->bin_type)) ;
 		return 1 ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_BODY ;
-	// fixup size at the very end
-	// no explicit data block, it's composed of sub blocks
-	return 0 ;
-}
-
-int gen_block_body(struct node *node, FILE *outfile)
-{
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	struct node *list = root ;
+	if( synthetic_block(context,&list,KEY_AQLV,0) == NULL ) return 1 ;
+	if( synthetic_block(context,&list,KEY_HEAD,0) == NULL ) return 1 ;
+	struct block_sign *sign = synthetic_block(context,&list,KEY_sign,sizeof(struct block_sign)) ;
+	if( sign == NULL ) return 1 ;
+	sign->version = (fourcc )0x322e3030 ;			// "2.00"
+	sign->filetype = (fourcc )0x54535453 ;			// "TSTS"
+	sign->sitecode = (fourcc )0x424e4348 ;			// "BNCH"
+	strcpy(sign->description,"synthetic") ;
+	strcpy(sign->ownername,"tsbench") ;
+	strcpy(sign->comment,"none") ;				// tsgen cannot read back an empty text field
+	struct block_mcda *mcda = synthetic_block(context,&list,KEY_mcda,sizeof(struct block_mcda)) ;
+	if( mcda == NULL ) return 1 ;
+	mcda->timestamp = 3600000000u ;				// 2018-01-28, tsgen cannot read back a zero timestamp either
+	struct block_cnst *cnst = synthetic_block(context,&list,KEY_cnst,sizeof(struct block_cnst)) ;
+	if( cnst == NULL ) return 1 ;
+	cnst->nchannels = params->channels ;
+	cnst->nsweeps = params->sweep_sets ;
+	cnst->nsamples = params->samples ;
+	cnst->iqindicator = 2 ;
+	struct block_swep *swep = synthetic_block(context,&list,KEY_swep,sizeof(struct block_swep)) ;
+	if( swep == NULL ) return 1 ;
+	swep->samplespersweep = params->samples ;
+	swep->sweepstart = 4.5e6 ;
+	swep->sweepbandwidth = -25733.91324595400874386542 ;
+	swep->sweeprate = 1 ;
+	struct block_fbin *fbin = synthetic_block(context,&list,KEY_fbin,sizeof(struct block_fbin)) ;
+	if( fbin == NULL ) return 1 ;
+	fbin->bin_format = BINFORMAT_CVIQ ;
+	fbin->bin_type = params->bin_type ;
+	if( synthetic_block(context,&list,KEY_BODY,0) == NULL ) return 1 ;
+	uint32_t random = 1 ;
+	for( int sweep = 0 ; sweep < params->sweep_sets ; sweep++ )
+	{
+		struct block_gtag *gtag = synthetic_block(context,&list,KEY_gtag,sizeof(struct block_gtag)) ;
+		struct block_atag *atag = synthetic_block(context,&list,KEY_atag,sizeof(struct block_atag)) ;
+		struct block_indx *indx = synthetic_block(context,&list,KEY_indx,sizeof(struct block_indx)) ;
+		struct block_scal *scal = synthetic_block(context,&list,KEY_scal,sizeof(struct block_scal)) ;
+		if( gtag == NULL || atag == NULL || indx == NULL || scal == NULL ) return 1 ;
+		indx->index = sweep + 1 ;
+		scal->scalar_one = 0.5 ;
+		scal->scalar_two = 0.25 ;
+		for( int channel = 0 ; channel < params->channels ; channel++ )
+		{
+			unsigned char *samples = synthetic_block(context,&list,KEY_alvl,params->samples*2*codec->width) ;
+			if( samples == NULL ) return 1 ;
+			for( int sample = 0 ; sample < 2*params->samples ; sample++ )
+			{
+				random = random*1103515245 + 12345 ;	// any full range values will do, the top bits are the most random
+				double value = (int32_t )random >> (32 - 8*codec->width) ;
+				if( codec->floating )
+					value = (int16_t )(random >> 16)/32768.0 ;
+				(*codec->store)(&value,1,samples+sample*codec->width) ;
+			}
+		}
+	}
+	if( synthetic_block(context,&list,KEY_END,0) == NULL ) return 1 ;
+	return fixup_sizes(root) ;
 }
 
-
-struct block_gtag
-{
-	uint32_t gtag ;		// unknown
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_gtag(struct node *node)
+void *synthetic_block(struct parse_context *context, struct node **list, fourcc key, size_t size)	// links a node with zeroed data after *list, returns the data, or list itself for a superblock
 {
-	if( node->size < sizeof(struct block_gtag) )
-	{
-		printf("Block '%s' is truncated\n",strkey(KEY_gtag)) ;
-		return 1 ;
-	}
-	struct block_gtag *gtag = (struct block_gtag *)node->data ;
-	endian_fixup(&(gtag->gtag),sizeof(gtag->gtag)) ;			// fixup the endian order
-	return 0 ;
+	struct node *newnode = new_node(context,*list,key) ;
+	if( newnode == NULL ) return NULL ;
+	*list = newnode ;
+	if( size == 0 )
+		return newnode ;
+	return new_data(context,newnode,size) ;
 }
 
-int dump_block_gtag(struct node *node, struct config *config, FILE *outfile)
+double bench_seconds(void)	// monotonic wall clock time in seconds
 {
-	if( node->size < sizeof(struct block_gtag) )
-	{
-		printf("Block '%s' is truncated\n",strkey(KEY_gtag)) ;
-		return 1 ;
-	}
-	struct block_gtag *gtag = (struct block_gtag *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_gtag)) ;
-	fprintf(outfile,"gtag:%u\n",gtag->gtag) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	struct timespec now ;
+	clock_gettime(CLOCK_MONOTONIC,&now) ;
+	return now.tv_sec + now.tv_nsec*1e-9 ;
 }
 
-int make_node_gtag(struct node *list, struct config *config, FILE *fd)		// creates a new node for gtag block
+double cpu_seconds(void)	// cpu time used by all threads of the process, in seconds
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
-	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
-	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_gtag ;
-	struct block_gtag *gtag = malloc(sizeof(struct block_gtag)) ;
-	if( gtag == NULL )
-	{
-		printf("Malloc error on data block\n") ;
-		return 1 ;
-	}
-	memset(gtag,0,sizeof(struct block_gtag)) ;
-	newnode->data = (unsigned char *)gtag ;
-	newnode->size = sizeof(struct block_gtag) ;
-	if( read_parameter(fd,"gtag:%u",(void *)&(gtag->gtag)) ) return 1 ;
-	return 0 ;
+	struct timespec now ;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&now) ;
+	return now.tv_sec + now.tv_nsec*1e-9 ;
 }
 
-int gen_block_gtag(struct node *node, FILE *outfile)
+void stats_start(struct run_stats *stats, struct stats_clock *clock)	// starts timing a stretch of a phase, nothing happens if stats is NULL
 {
-	struct block_gtag *gtag = (struct block_gtag *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(gtag->gtag),sizeof(gtag->gtag)) ;
-	if( fwrite(&(gtag->gtag),sizeof(gtag->gtag),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	if( stats == NULL ) return ;
+	clock->wall = bench_seconds() ;
+	clock->cpu = cpu_seconds() ;
 }
 
-struct block_atag
+void stats_stop(struct run_stats *stats, int phase, struct stats_clock *clock)	// adds the time since stats_start() to the phase
 {
-	uint32_t atag ;		// unknown
-} __attribute__((packed)) ;	// make sure there's no padding
+	if( stats == NULL ) return ;
+	stats->wall[phase] += bench_seconds() - clock->wall ;
+	stats->cpu[phase] += cpu_seconds() - clock->cpu ;
+}
 
-int fixup_data_atag(struct node *node)
+void count_block(struct config *counts, fourcc key, uint32_t size, fourcc bin_type)	// adds a block to the count_ fields of a config, bin_type gives the width of alvl samples
 {
-	if( node->size < sizeof(struct block_atag) )
+	counts->count_all++ ;
+	switch( (uint32_t )key )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_atag)) ;
-		return 1 ;
+		case (uint32_t )KEY_AQLV: counts->count_aqlv++ ; break ;
+		case (uint32_t )KEY_HEAD: counts->count_head++ ; break ;
+		case (uint32_t )KEY_sign: counts->count_sign++ ; break ;
+		case (uint32_t )KEY_mcda: counts->count_mcda++ ; break ;
+		case (uint32_t )KEY_cnst: counts->count_cnst++ ; break ;
+		case (uint32_t )KEY_swep: counts->count_swep++ ; break ;
+		case (uint32_t )KEY_fbin: counts->count_fbin++ ; break ;
+		case (uint32_t )KEY_BODY: counts->count_body++ ; break ;
+		case (uint32_t )KEY_gtag: counts->count_gtag++ ; break ;
+		case (uint32_t )KEY_atag: counts->count_atag++ ; break ;
+		case (uint32_t )KEY_indx: counts->count_indx++ ; break ;
+		case (uint32_t )KEY_scal: counts->count_scal++ ; break ;
+		case (uint32_t )KEY_alvl:
+			counts->count_alvl++ ;
+			counts->count_samples += size/(2*sample_layout(bin_type)->width) ;
+		break ;
+		case (uint32_t )KEY_END: counts->count_end++ ; break ;
+		default: counts->count_other++ ; break ;
 	}
-	struct block_atag *atag = (struct block_atag *)node->data ;
-	endian_fixup(&(atag->atag),sizeof(atag->atag)) ;			// fixup the endian order
-	return 0 ;
 }
 
-int dump_block_atag(struct node *node, struct config *config, FILE *outfile)
+uint64_t file_bytes(FILE *file)	// the size of a regular file, or how far a pipe was read or written
 {
-	if( node->size < sizeof(struct block_atag) )
-	{
-		printf("Block '%s' is truncated\n",strkey(KEY_atag)) ;
-		return 1 ;
-	}
-	struct block_atag *atag = (struct block_atag *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_atag)) ;
-	fprintf(outfile,"atag:%u\n",atag->atag) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	struct stat st ;
+	if( fstat(fileno(file),&st) == 0 && S_ISREG(st.st_mode) )
+		return st.st_size ;
+	long position = ftell(file) ;
+	return ( position > 0 ) ? position : 0 ;
 }
 
-int make_node_atag(struct node *list, struct config *config, FILE *fd)		// creates a new node for atag block
+int report_stats(struct run_stats *stats, char *program_name)	// prints the --stats report on stderr, or writes it as JSON
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
+	double wall_total = bench_seconds() - stats->wall_start ;
+	double cpu_total = cpu_seconds() - stats->cpu_start ;
+	struct rusage usage ;
+	long peak_rss = ( getrusage(RUSAGE_SELF,&usage) == 0 ) ? usage.ru_maxrss : 0 ;	// in kB
+#if defined(__APPLE__)
+	peak_rss /= 1024 ;		// macOS gives it in bytes
+#endif
+	struct config *counts = &(stats->counts) ;
+	struct { char *name ; unsigned long count ; } blocks[] =
 	{
-		printf("Malloc error on list node\n") ;
+		{ "AQVL", counts->count_aqlv }, { "HEAD", counts->count_head }, { "sign", counts->count_sign },
+		{ "mcda", counts->count_mcda }, { "cnst", counts->count_cnst }, { "swep", counts->count_swep },
+		{ "fbin", counts->count_fbin }, { "BODY", counts->count_body }, { "gtag", counts->count_gtag },
+		{ "atag", counts->count_atag }, { "indx", counts->count_indx }, { "scal", counts->count_scal },
+		{ "alvl", counts->count_alvl }, { "END", counts->count_end }, { "other", counts->count_other },
+		{ "bad", counts->count_bad }
+	} ;
+	int nblocks = sizeof(blocks)/sizeof(blocks[0]) ;
+	if( stats->jsonname == NULL )
+	{
+		fprintf(stderr,"%s statistics\n",program_name) ;
+		fprintf(stderr,"blocks     %u",counts->count_all) ;
+		for( int loop = 0 ; loop < nblocks ; loop++ )
+			fprintf(stderr,"%s%s %lu",loop ? ", " : " (",blocks[loop].name,blocks[loop].count) ;
+		fprintf(stderr,")\n") ;
+		fprintf(stderr,"samples    %lu\n",counts->count_samples) ;
+		fprintf(stderr,"phase      wall s     cpu s\n") ;
+		for( int phase = 0 ; phase < STATS_PHASES ; phase++ )
+			fprintf(stderr,"%-10s %-10.6f %.6f\n",Global_stats_phase_names[phase],stats->wall[phase],stats->cpu[phase]) ;
+		fprintf(stderr,"%-10s %-10.6f %.6f\n","total",wall_total,cpu_total) ;
+		fprintf(stderr,"bytes in   %llu\n",(unsigned long long )stats->bytes_in) ;
+		fprintf(stderr,"bytes out  %llu\n",(unsigned long long )stats->bytes_out) ;
+		fprintf(stderr,"peak RSS   %ld kB\n",peak_rss) ;
+		return 0 ;
+	}
+	FILE *report = fopen(stats->jsonname,"w") ;
+	if( report == NULL )
+	{
+		printf("Cannot open output file '%s'\n",stats->jsonname) ;
 		return 1 ;
 	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_atag ;
-	struct block_atag *atag = malloc(sizeof(struct block_atag)) ;
-	if( atag == NULL )
+	fprintf(report,"{\n") ;
+	fprintf(report,"  \"program\": \"%s\",\n",program_name) ;
+	fprintf(report,"  \"blocks\": { \"all\": %u",counts->count_all) ;
+	for( int loop = 0 ; loop < nblocks ; loop++ )
+		fprintf(report,", \"%s\": %lu",blocks[loop].name,blocks[loop].count) ;
+	fprintf(report," },\n") ;
+	fprintf(report,"  \"samples\": %lu,\n",counts->count_samples) ;
+	fprintf(report,"  \"phases\": {\n") ;
+	for( int phase = 0 ; phase < STATS_PHASES ; phase++ )
+		fprintf(report,"    \"%s\": { \"wall\": %.6f, \"cpu\": %.6f },\n",Global_stats_phase_names[phase],stats->wall[phase],stats->cpu[phase]) ;
+	fprintf(report,"    \"total\": { \"wall\": %.6f, \"cpu\": %.6f }\n",wall_total,cpu_total) ;
+	fprintf(report,"  },\n") ;
+	fprintf(report,"  \"bytes_in\": %llu,\n",(unsigned long long )stats->bytes_in) ;
+	fprintf(report,"  \"bytes_out\": %llu,\n",(unsigned long long )stats->bytes_out) ;
+	fprintf(report,"  \"peak_rss_kb\": %ld\n",peak_rss) ;
+	fprintf(report,"}\n") ;
+	if( fclose(report) != 0 )
 	{
-		printf("Malloc error on data block\n") ;
+		printf("Error writing '%s'\n",stats->jsonname) ;
 		return 1 ;
 	}
-	memset(atag,0,sizeof(struct block_atag)) ;
-	newnode->data = (unsigned char *)atag ;
-	newnode->size = sizeof(struct block_atag) ;
-	if( read_parameter(fd,"atag:%u",(void *)&(atag->atag)) ) return 1 ;
-	return 0 ;
-}
-
-int gen_block_atag(struct node *node, FILE *outfile)
-{
-	struct block_atag *atag = (struct block_atag *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(atag->atag),sizeof(atag->atag)) ;
-	if( fwrite(&(atag->atag),sizeof(atag->atag),1,outfile) != 1 ) return 1 ;
 	return 0 ;
 }
 
+#define ARENA_NODE_CHUNK	(64*1024)	// nodes and header data blocks
+#define ARENA_SLAB_CHUNK	(1024*1024)	// alvl payloads
+#define ARENA_ALIGN		16
+#define ARENA_HEADER		((sizeof(struct arena_chunk) + ARENA_ALIGN - 1) & ~(size_t )(ARENA_ALIGN - 1))
 
-struct block_indx
-{
-	uint32_t index ;		// index
-} __attribute__((packed)) ;	// make sure there's no padding
-
-int fixup_data_indx(struct node *node)
+void *arena_alloc(struct arena *arena, size_t size)	// returns size bytes from the current chunk, starting a new chunk when it is full
 {
-	if( node->size < sizeof(struct block_indx) )
+	size = (size + ARENA_ALIGN - 1) & ~(size_t )(ARENA_ALIGN - 1) ;
+	struct arena_chunk *chunk = arena->chunk ;
+	if( chunk == NULL || chunk->used + size > chunk->size )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_indx)) ;
-		return 1 ;
+		size_t chunk_size = ( size > arena->chunk_size ) ? size : arena->chunk_size ;
+		chunk = malloc(ARENA_HEADER + chunk_size) ;
+		if( chunk == NULL )
+		{
+			printf("Cannot get memory for %zu byte arena chunk\n",chunk_size) ;
+			return NULL ;
+		}
+		chunk->next = arena->chunk ;
+		chunk->size = chunk_size ;
+		chunk->used = 0 ;
+		arena->chunk = chunk ;
 	}
-	struct block_indx *indx = (struct block_indx *)node->data ;
-	endian_fixup(&(indx->index),sizeof(indx->index)) ;			// fixup the endian order
-	return 0 ;
+	chunk->last = chunk->used ;
+	chunk->used += size ;
+	return (unsigned char *)chunk + ARENA_HEADER + chunk->last ;
 }
 
-int dump_block_indx(struct node *node, struct config *config, FILE *outfile)
+void *arena_resize(struct arena *arena, void *data, size_t old_size, size_t new_size)	// grows the most recent allocation in place if there is room, otherwise moves it
 {
-	if( node->size < sizeof(struct block_indx) )
+	struct arena_chunk *chunk = arena->chunk ;
+	size_t aligned = (new_size + ARENA_ALIGN - 1) & ~(size_t )(ARENA_ALIGN - 1) ;
+	if( chunk != NULL && (unsigned char *)data == (unsigned char *)chunk + ARENA_HEADER + chunk->last && chunk->last + aligned <= chunk->size )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_indx)) ;
-		return 1 ;
+		chunk->used = chunk->last + aligned ;
+		return data ;
 	}
-	struct block_indx *indx = (struct block_indx *)(node->data) ;
-	fprintf(outfile,"%s\n",strkey(KEY_indx)) ;
-	fprintf(outfile,"index:%u\n",indx->index) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	void *moved = arena_alloc(arena,new_size) ;
+	if( moved != NULL )
+		memcpy(moved,data,old_size) ;
+	return moved ;
 }
 
-int make_node_indx(struct node *list, struct config *config, FILE *fd)		// creates a new node for indx block
+void arena_reset(struct arena *arena)	// forgets all allocations but keeps the current chunk for reuse
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
-	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
-	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_indx ;
-	struct block_indx *indx = malloc(sizeof(struct block_indx)) ;
-	if( indx == NULL )
+	struct arena_chunk *chunk = arena->chunk ;
+	if( chunk == NULL ) return ;
+	struct arena_chunk *older = chunk->next ;
+	while( older != NULL )
 	{
-		printf("Malloc error on data block\n") ;
-		return 1 ;
+		struct arena_chunk *next = older->next ;
+		free(older) ;
+		older = next ;
 	}
-	memset(indx,0,sizeof(struct block_indx)) ;
-	newnode->data = (unsigned char *)indx ;
-	newnode->size = sizeof(struct block_indx) ;
-	if( read_parameter(fd,"index:%u",(void *)&(indx->index)) ) return 1 ;
-	return 0 ;
+	chunk->next = NULL ;
+	chunk->used = 0 ;
+	chunk->last = 0 ;
 }
 
-int gen_block_indx(struct node *node, FILE *outfile)
+void arena_release(struct arena *arena)	// frees every chunk
 {
-	struct block_indx *indx = (struct block_indx *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(indx->index),sizeof(indx->index)) ;
-	if( fwrite(&(indx->index),sizeof(indx->index),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	arena_reset(arena) ;
+	free(arena->chunk) ;
+	arena->chunk = NULL ;
 }
 
-
-struct block_scal
+void init_context(struct parse_context *context)
 {
-	double scalar_one ;		// scaling value for I samples
-	double scalar_two ;		// scaling value for Q samples
-} __attribute__((packed)) ;	// make sure there's no padding
+	memset(context,0,sizeof(struct parse_context)) ;
+	context->nodes.chunk_size = ARENA_NODE_CHUNK ;
+	context->slabs.chunk_size = ARENA_SLAB_CHUNK ;
+}
 
-int fixup_data_scal(struct node *node)
+void reset_context(struct parse_context *context)	// drops all nodes and data, the memory is kept for the next ones
 {
-	if( node->size < sizeof(struct block_scal) )
-	{
-		printf("Block '%s' is truncated\n",strkey(KEY_scal)) ;
-		return 1 ;
-	}
-	struct block_scal *scal = (struct block_scal *)node->data ;
-	endian_fixup(&(scal->scalar_one),sizeof(scal->scalar_one)) ;
-	endian_fixup(&(scal->scalar_two),sizeof(scal->scalar_two)) ;
-	return 0 ;
+	arena_reset(&(context->nodes)) ;
+	arena_reset(&(context->slabs)) ;
 }
 
-int dump_block_scal(struct node *node, struct config *config, FILE *outfile)
+void release_context(struct parse_context *context)
 {
-	if( node->size < sizeof(struct block_scal) )
-	{
-		printf("Block '%s' is truncated\n",strkey(KEY_scal)) ;
-		return 1 ;
-	}
-	struct block_scal *scal = (struct block_scal *)(node->data) ;
-	config->scalar_one = scal->scalar_one ;	// remember this for alvl blocks
-	config->scalar_two = scal->scalar_two ;	// remember this for alvl blocks
-	fprintf(outfile,"%s\n",strkey(KEY_scal)) ;
-	fprintf(outfile,"scalar_one:%.20lf\n",scal->scalar_one) ;
-	fprintf(outfile,"scalar_two:%.20lf\n",scal->scalar_two) ;
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	arena_release(&(context->nodes)) ;
+	arena_release(&(context->slabs)) ;
 }
 
-int make_node_scal(struct node *list, struct config *config, FILE *fd)		// creates a new node for scal block
+struct node *new_node(struct parse_context *context, struct node *list, fourcc key)	// makes a node for a key and links it after list
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
+	struct node *newnode = arena_alloc(&(context->nodes),sizeof(struct node)) ;
 	if( newnode == NULL )
 	{
 		printf("Malloc error on list node\n") ;
-		return 1 ;
+		return NULL ;
 	}
 	memset(newnode,0,sizeof(struct node)) ;
+	newnode->key = key ;
 	list->next = newnode ;
-	newnode->key = KEY_scal ;
-	struct block_scal *scal = malloc(sizeof(struct block_scal)) ;
-	if( scal == NULL )
-	{
-		printf("Malloc error on data block\n") ;
-		return 1 ;
-	}
-	memset(scal,0,sizeof(struct block_scal)) ;
-	newnode->data = (unsigned char *)scal ;
-	newnode->size = sizeof(struct block_scal) ;
-	if( read_parameter(fd,"scalar_one:%lf",(void *)&(scal->scalar_one)) ) return 1 ;
-	if( read_parameter(fd,"scalar_two:%lf",(void *)&(scal->scalar_two)) ) return 1 ;
-	config->scalar_one = scal->scalar_one ;	// remember this for alvl blocks
-	config->scalar_two = scal->scalar_two ;	// remember this for alvl blocks
-	return 0 ;
+	return newnode ;
 }
 
-int gen_block_scal(struct node *node, FILE *outfile)
+void *new_data(struct parse_context *context, struct node *node, size_t size)	// gives a node a zeroed data block of size bytes
 {
-	struct block_scal *scal = (struct block_scal *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(scal->scalar_one),sizeof(scal->scalar_one)) ;
-	if( fwrite(&(scal->scalar_one),sizeof(scal->scalar_one),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(scal->scalar_two),sizeof(scal->scalar_two)) ;
-	if( fwrite(&(scal->scalar_two),sizeof(scal->scalar_two),1,outfile) != 1 ) return 1 ;
-	return 0 ;
+	void *data = arena_alloc(&(context->nodes),size) ;
+	if( data == NULL )
+	{
+		printf("Malloc error on data block\n") ;
+		return NULL ;
+	}
+	memset(data,0,size) ;
+	node->data = data ;
+	node->size = size ;
+	return data ;
 }
 
+// libts, the interface declared in ts.h
 
-struct block_alvl
+struct ts_file *new_ts_file(void)
 {
-	int16_t isample ;		// I sample
-	int16_t qsample ;		// Q sample
-} __attribute__((packed)) ;	// make sure there's no padding
+	struct ts_file *file = calloc(1,sizeof(struct ts_file)) ;
+	if( file == NULL )
+	{
+		printf("Cannot get memory for a ts file handle\n") ;
+		return NULL ;
+	}
+	init_context(&(file->context)) ;
+	return file ;
+}
 
-int fixup_data_alvl(struct node *node)
+struct ts_file *ts_open(const char *filename)	// maps and parses a binary file, the nodes and samples point into the mapping
 {
-	if( node->size < sizeof(struct block_alvl) )
+	struct ts_file *file = new_ts_file() ;
+	if( file == NULL ) return NULL ;
+	file->filedata = load_binary_file(filename,&(file->filesize),&(file->mapped)) ;
+	if( file->filedata == NULL )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_alvl)) ;
-		return 1 ;
+		ts_close(file) ;
+		return NULL ;
 	}
-	struct block_alvl *alvl = (struct block_alvl *)node->data ;
-	int nsamples = (node->size)/sizeof(struct block_alvl) ;
-	for( int loop = 0 ; loop < nsamples ; loop++, alvl++ )
+	file->root.next = parse_file(&(file->context),file->filedata,file->filesize) ;
+	if( file->root.next == NULL || find_sweep_sets(file) )
 	{
-		endian_fixup(&(alvl->isample),sizeof(alvl->isample)) ;
-		endian_fixup(&(alvl->qsample),sizeof(alvl->qsample)) ;
+		ts_close(file) ;
+		return NULL ;
 	}
-	return 0 ;
+	return file ;
 }
 
-int dump_block_alvl(struct node *node, struct config *config, FILE *outfile)
+int ts_walk(const char *filename, struct ts_events *events)	// calls back for each block of a binary file without building a list
+{
+	unsigned long filesize ;
+	int mapped ;
+	unsigned char *filedata = load_binary_file(filename,&filesize,&mapped) ;
+	if( filedata == NULL ) return 1 ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	int err = walk_blocks(events,filedata,filesize,&config,NULL) ;
+	unload_binary_file(filedata,filesize,mapped) ;
+	return err ;
+}
+
+unsigned char *load_binary_file(const char *filename, unsigned long *filesize, int *mapped)	// maps a binary file copy-on-write, or reads it if it cannot be mapped, and checks its header
 {
-	if( node->size < sizeof(struct block_alvl) )
+	FILE *infile = fopen(filename,"rb") ;
+	if( infile == NULL )
 	{
-		printf("Block '%s' is truncated\n",strkey(KEY_alvl)) ;
-		return 1 ;
+		printf("Cannot open input file '%s'\n",filename) ;
+		return NULL ;
 	}
-	double factor = 1.0L ;
-	switch ( (uint32_t )config->bin_type )
+	unsigned char *filedata = map_binary_file(infile,filesize) ;
+	*mapped = ( filedata != NULL ) ;
+	if( !*mapped && (filedata = read_binary_file(infile,filesize)) == NULL )
 	{
-		case (uint32_t )BINTYPE_FLT4:
-			factor = (double )1 ;
-		break ;
-		case (uint32_t )BINTYPE_FIX2:
-			factor = (double )0x7FFF ;
-		break ;
-		case (uint32_t )BINTYPE_FIX3:
-			factor = (double )0x7FFFFF ;
-		break ;
-		case (uint32_t )BINTYPE_FIX4:
-			factor = (double )0x7FFFFFFF ;
-		break ;
-		default:
-			printf("Unknown bin_type '%s' (%x) at index %d\n",strkey(config->bin_type),config->bin_type,config->index) ;
-			return 1;
+		printf("Cannot read file '%s'\n",filename) ;
+		fclose(infile) ;
+		return NULL ;
 	}
-	fprintf(outfile,"%s\n",strkey(KEY_alvl)) ;
-	struct block_alvl *alvl = (struct block_alvl *)(node->data) ;
-	int nsamples = (node->size)/sizeof(struct block_alvl) ;
-	for( int loop = 0 ; loop < nsamples ; loop++, alvl++ )
+	fclose(infile) ;
+	if( *filesize < sizeof(struct block_header) || check_header(filedata) )
 	{
-		int isample = alvl->isample ;
-		int qsample = alvl->qsample ;
-		double scaled_i = (double )isample/factor*config->scalar_one ;	// precedence order?
-		double scaled_q = (double )qsample/factor*config->scalar_two ;
-		fprintf(outfile,"i:%.20lf\n",scaled_i) ;
-		fprintf(outfile,"q:%.20lf\n",scaled_q) ;
+		unload_binary_file(filedata,*filesize,*mapped) ;
+		return NULL ;
 	}
-	fprintf(outfile,"\n") ;
-	return 0 ;
+	return filedata ;
 }
 
-int read_alvl_samples(struct block_alvl *, int, struct config *, FILE *) ;
+void unload_binary_file(unsigned char *filedata, unsigned long filesize, int mapped)
+{
+	if( mapped )
+		munmap(filedata,filesize) ;
+	else
+		free(filedata) ;
+}
 
-int make_node_alvl(struct node *list, struct config *config, FILE *fd)		// creates a new node for alvl block
+struct ts_file *ts_open_text(const char *filename)	// parses a text file the way tsgen does, keeping the whole list
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
-	{
-		printf("Malloc error on list node\n") ;
-		return 1 ;
-	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_alvl ;
-	int alvl_lines = count_alvl_lines(fd) ;		// count lines, 2 lines per sample (i and q), use this to malloc space for the entire block
-	if( alvl_lines <= 0 )
-	{
-		printf("Error counting lines in '%s' block\n",strkey(KEY_alvl)) ;
-		return 1 ;
-	}
-	if( alvl_lines % 2 == 1 )
+	FILE *infile = fopen(filename,"r") ;
+	if( infile == NULL )
 	{
-		printf("Cannot deal with an odd number of lines (%d) reading '%s' block\n",alvl_lines,strkey(KEY_alvl)) ;
-		return 1 ;
+		printf("Cannot open input file '%s'\n",filename) ;
+		return NULL ;
 	}
-	//printf("debug: make_node_alvl: alvl_lines=%u\n",alvl_lines) ;
-	int alvl_samples = alvl_lines/2 ;	// a sample is a pair of I,Q values
-	size_t alvl_size = alvl_samples * sizeof(struct block_alvl) ;
-	//printf("debug: make_node_alvl: alvl_samples=%d alvl_size=%zu\n",alvl_samples,alvl_size) ;
-	struct block_alvl *alvl_data = malloc(alvl_size) ;
-	if( alvl_data == NULL )
+	struct ts_file *file = new_ts_file() ;
+	if( file == NULL )
 	{
-		printf("Malloc error on '%s' data block\n",strkey(KEY_alvl)) ;
-		return 1 ;
+		fclose(infile) ;
+		return NULL ;
 	}
-	memset(alvl_data,0,alvl_size) ;
-	newnode->data = (unsigned char *)alvl_data ;
-	newnode->size = alvl_size ;
-	if( read_alvl_samples(alvl_data,alvl_samples,config,fd) )	// read lines of i, q values, convert them into ints and store them in alvl_data
+	int err = read_text_list(infile,&(file->context),&(file->root)) ;
+	fclose(infile) ;
+	if( err || fixup_sizes(&(file->root)) || find_sweep_sets(file) )
 	{
-		printf("Error reading '%s' block\n",strkey(KEY_alvl)) ;
-		return 1 ;
+		ts_close(file) ;
+		return NULL ;
 	}
-	return 0 ;
+	return file ;
 }
 
-int count_alvl_lines(FILE *fd)		// count how many lines of i,q data there are before we hit a blank line (end of block)
+int read_text_list(FILE *infile, struct parse_context *context, struct node *root)	// makes a node after root for every block in the text, the sizes are left to fixup_sizes()
 {
-	char line[SIZE_LINE] ;
-	int count = 0 ;
-	unsigned long alvl_start = ftell(fd) ;
-	while( fgets(line,SIZE_LINE,fd) != NULL )
+	struct text_reader reader ;
+	memset(&reader,0,sizeof(struct text_reader)) ;
+	reader.fd = infile ;
+	struct config config ;
+	memset(&config,0,sizeof(struct config)) ;
+	struct node *list = root ;
+	int err = 0 ;
+	char *line ;
+	while( (line = read_line(&reader)) != NULL )
 	{
-		chomp(line,SIZE_LINE) ;				// remove newline
-		if( strlen(line) < 1 )
-			break ;
-		count++ ;
+		err = make_block(context,list,&config,&reader,line) ;
+		if( err ) break ;
+		while( list->next != NULL )
+			list = list->next ;
 	}
-	fseek(fd,alvl_start,SEEK_SET) ;
-	return count ;
+	free(reader.buffer) ;
+	free(reader.block) ;
+	return err ;
 }
 
-int read_alvl_samples(struct block_alvl *alvl_data, int alvl_samples, struct config *config, FILE *fd)
+void ts_close(struct ts_file *file)
 {
-	char line1[SIZE_LINE] ;
-	char line2[SIZE_LINE] ;
-	double factor = 1.0L ;
-	unsigned long alvl_start = ftell(fd) ;
-	switch ( (uint32_t )config->bin_type )
-	{
-		case (uint32_t )BINTYPE_FLT4:
-			factor = (double )1 ;
-		break ;
-		case (uint32_t )BINTYPE_FIX2:
-			factor = (double )0x7FFF ;
-		break ;
-		case (uint32_t )BINTYPE_FIX3:
-			factor = (double )0x7FFFFF ;
-		break ;
-		case (uint32_t )BINTYPE_FIX4:
-			factor = (double )0x7FFFFFFF ;
-		break ;
-		default:
-			printf("Unknown bin_type '%s' (%x) at index %d\n",strkey(config->bin_type),config->bin_type,config->index) ;
-			return 1;
-	}
-	for( int sample_count = 0 ; sample_count < alvl_samples ; sample_count++, alvl_data++ )
+	if( file == NULL ) return ;
+	release_context(&(file->context)) ;
+	if( file->filedata != NULL )
+		unload_binary_file(file->filedata,file->filesize,file->mapped) ;
+	free(file->sweeps) ;
+	free(file) ;
+}
+
+int find_sweep_sets(struct ts_file *file)	// notes the first node of each sweep set in BODY
+{
+	size_t allocated = 0 ;
+	int in_body = 0 ;
+	int previous_alvl = 0 ;
+	for( struct node *node = file->root.next ; node != NULL ; node = node->next )
 	{
-		if( fgets(line1,SIZE_LINE,fd) == NULL ) return 1 ;
-		if( fgets(line2,SIZE_LINE,fd) == NULL ) return 1 ;
-		chomp(line1,SIZE_LINE) ; chomp(line2,SIZE_LINE) ;
-		if( strlen(line1) == 0 ) return 1 ;
-		if( strlen(line2) == 0 ) return 1 ;
-		double i ; double q ;
-		int convert_count = sscanf(line1,"i:%lf",&i) ;
-		if( convert_count != 1 )
+		if( node->key == KEY_BODY )
 		{
-			printf("Failed to read 'i' value %d from line %s\n",sample_count,line1) ;
-			return 1 ;
+			in_body = 1 ;
+			continue ;
 		}
-		convert_count = sscanf(line2,"q:%lf",&q) ;
-		if( convert_count != 1 )
+		if( node->key == KEY_END )
+			break ;
+		if( !in_body )
+			continue ;
+		if( file->nsweeps == 0 || (previous_alvl && node->key != KEY_alvl) )	// the first block after a run of alvl blocks starts a new sweep set
 		{
-			printf("Failed to read 'q' value %d from line %s\n",sample_count,line2) ;
-			return 1 ;
+			if( file->nsweeps == allocated )
+			{
+				allocated = allocated ? 2*allocated : 1024 ;
+				struct node **sweeps = realloc(file->sweeps,allocated*sizeof(struct node *)) ;
+				if( sweeps == NULL )
+				{
+					printf("Cannot get memory for %zu sweep sets\n",allocated) ;
+					return 1 ;
+				}
+				file->sweeps = sweeps ;
+			}
+			file->sweeps[file->nsweeps++] = node ;
 		}
-		double i_scaled = (i/config->scalar_one)*factor ;
-		double q_scaled = (q/config->scalar_two)*factor ;
-		int i_int = round(i_scaled) ;
-		int q_int = round(q_scaled) ;
-		alvl_data->isample = i_int ;
-		alvl_data->qsample = q_int ;
-		//if( sample_count == 0 ) printf("debug: read_alvl_samples: double i=%lf q=%lf, scalar_one=%lf scalar_two=%lf, factor=%lf int i=%d q=%d\n",i,q,config->scalar_one,config->scalar_two,factor,alvl_data->isample,alvl_data->qsample) ;
+		previous_alvl = ( node->key == KEY_alvl ) ;
 	}
-	fseek(fd,alvl_start,SEEK_SET) ;
 	return 0 ;
 }
 
-int gen_block_alvl(struct node *node, FILE *outfile)
+struct node *find_head_block(struct ts_file *file, fourcc key)	// returns the node of a HEAD block, or NULL if the file has none
 {
-	struct block_alvl *alvl = (struct block_alvl *)(node->data) ;
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	int actual_size = node->size ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
-	int sample_count = actual_size/sizeof(struct block_alvl) ;
-	//printf("debug: gen_block_alvl: actual size %d, sample_count %d\n",actual_size,sample_count) ;
-	for( int count = 0 ; count < sample_count ; count++, alvl++ )
-	{
-		//if( count == 0 ) printf("debug: gen_block_alvl: sample 0 i=%d q=%d\n",alvl->isample,alvl->qsample) ;
-		endian_fixup(&(alvl->isample),sizeof(alvl->isample)) ;
-		if( fwrite(&(alvl->isample),sizeof(alvl->isample),1,outfile) != 1 ) return 1 ;
-		endian_fixup(&(alvl->qsample),sizeof(alvl->qsample)) ;
-		if( fwrite(&(alvl->qsample),sizeof(alvl->qsample),1,outfile) != 1 ) return 1 ;
-	}
-	return 0 ;
+	for( struct node *node = file->root.next ; node != NULL && node->key != KEY_BODY ; node = node->next )
+		if( node->key == key )
+			return node ;
+	printf("There is no '%s' block\n",strkey(key)) ;
+	return NULL ;
 }
 
+fourcc file_bin_type(struct ts_file *file)	// the bin_type of the fbin block, 0 if there is none
+{
+	for( struct node *node = file->root.next ; node != NULL && node->key != KEY_BODY ; node = node->next )
+		if( node->key == KEY_fbin && node->size >= sizeof(struct block_fbin) )
+			return ((struct block_fbin *)(node->data))->bin_type ;
+	return 0 ;
+}
 
-int fixup_data_end(struct node *node)
+int ts_get_sign(struct ts_file *file, struct ts_sign *result)
 {
+	struct node *node = find_head_block(file,KEY_sign) ;
+	if( node == NULL ) return 1 ;
+	struct block_sign *sign = (struct block_sign *)(node->data) ;
+	memset(result,0,sizeof(struct ts_sign)) ;
+	strkey_r(sign->version,result->version) ;
+	strkey_r(sign->filetype,result->filetype) ;
+	strkey_r(sign->sitecode,result->sitecode) ;
+	result->userflags = sign->userflags ;
+	memcpy(result->description,sign->description,SIZE_DESCRIPTION) ;	// the results are one byte longer, so stay terminated
+	memcpy(result->ownername,sign->ownername,SIZE_OWNERNAME) ;
+	memcpy(result->comment,sign->comment,SIZE_COMMENT) ;
 	return 0 ;
 }
 
-int dump_block_end(struct node *node, struct config *config, FILE *outfile)
+int ts_get_cnst(struct ts_file *file, struct ts_cnst *result)
 {
-	fprintf(outfile,"%s\n",strkey(KEY_END)) ;
+	struct node *node = find_head_block(file,KEY_cnst) ;
+	if( node == NULL ) return 1 ;
+	struct block_cnst *cnst = (struct block_cnst *)(node->data) ;
+	result->nchannels = cnst->nchannels ;
+	result->nsweeps = cnst->nsweeps ;
+	result->nsamples = cnst->nsamples ;
+	result->iqindicator = cnst->iqindicator ;
 	return 0 ;
 }
 
-int make_node_end(struct node *list, struct config *config, FILE *fd)		// creates a new node for end block
+int ts_get_swep(struct ts_file *file, struct ts_swep *result)
 {
-	struct node *newnode = malloc(sizeof(struct node)) ;
-	if( newnode == NULL )
-	{
-		printf("Malloc error\n") ;
-		return 1 ;
-	}
-	memset(newnode,0,sizeof(struct node)) ;
-	list->next = newnode ;
-	newnode->key = KEY_END ;
-	newnode->size = 0 ;
-	newnode->data = NULL ;
+	struct node *node = find_head_block(file,KEY_swep) ;
+	if( node == NULL ) return 1 ;
+	struct block_swep *swep = (struct block_swep *)(node->data) ;
+	result->samplespersweep = swep->samplespersweep ;
+	result->sweepstart = swep->sweepstart ;
+	result->sweepbandwidth = swep->sweepbandwidth ;
+	result->sweeprate = swep->sweeprate ;
+	result->rangeoffset = swep->rangeoffset ;
 	return 0 ;
 }
 
-int gen_block_end(struct node *node, FILE *outfile)
+int ts_get_fbin(struct ts_file *file, struct ts_fbin *result)
 {
-	endian_fixup(&(node->key),sizeof(node->key)) ;
-	if( fwrite(&(node->key),sizeof(node->key),1,outfile) != 1 ) return 1 ;
-	endian_fixup(&(node->size),sizeof(node->size)) ;
-	if( fwrite(&(node->size),sizeof(node->size),1,outfile) != 1 ) return 1 ;
+	struct node *node = find_head_block(file,KEY_fbin) ;
+	if( node == NULL ) return 1 ;
+	struct block_fbin *fbin = (struct block_fbin *)(node->data) ;
+	strkey_r(fbin->bin_format,result->format) ;
+	strkey_r(fbin->bin_type,result->type) ;
 	return 0 ;
 }
 
+size_t ts_sweep_count(struct ts_file *file)
+{
+	return file->nsweeps ;
+}
 
-void free_all_nodes(struct node *list)
+int ts_get_sweep(struct ts_file *file, size_t position, struct ts_sweep *result)	// fills in one sweep set, the samples are not copied
 {
-	while( list != NULL )
+	if( position >= file->nsweeps )
 	{
-		struct node *next = list->next ;
-		free(list) ;
-		list = next ;
+		printf("No sweep set %zu, the file has %zu\n",position,file->nsweeps) ;
+		return 1 ;
+	}
+	memset(result,0,sizeof(struct ts_sweep)) ;
+	struct sample_codec *codec = sample_layout(file_bin_type(file)) ;
+	struct node *node = file->sweeps[position] ;
+	struct node *end = ( position+1 < file->nsweeps ) ? file->sweeps[position+1] : NULL ;
+	for( ; node != end && node->key != KEY_END ; node = node->next )
+	{
+		switch( (uint32_t )node->key )
+		{
+			case (uint32_t )KEY_gtag:
+				result->gtag = ((struct block_gtag *)(node->data))->gtag ;
+			break ;
+			case (uint32_t )KEY_atag:
+				result->atag = ((struct block_atag *)(node->data))->atag ;
+			break ;
+			case (uint32_t )KEY_indx:
+				result->index = ((struct block_indx *)(node->data))->index ;
+			break ;
+			case (uint32_t )KEY_scal:
+				result->scalar_one = ((struct block_scal *)(node->data))->scalar_one ;
+				result->scalar_two = ((struct block_scal *)(node->data))->scalar_two ;
+			break ;
+			case (uint32_t )KEY_alvl:
+				if( result->nchannels == TS_MAX_CHANNELS )
+				{
+					printf("Sweep set %zu has more than %d 'alvl' blocks\n",position,TS_MAX_CHANNELS) ;
+					return 1 ;
+				}
+				struct ts_channel *channel = &(result->channel[result->nchannels]) ;
+				channel->data = node->data ;
+				channel->width = codec->width ;
+				channel->count = node->size/(2*codec->width) ;
+				if( codec->bin_type == BINTYPE_FIX2 )
+					channel->samples = (const int16_t *)(node->data) ;
+				result->nchannels++ ;
+			break ;
+		}
 	}
+	return 0 ;
 }
 
-void free_all_nodes_and_data(struct node *list)
+int ts_get_values(struct ts_file *file, const struct ts_channel *channel, double *values)	// converts the samples of any bin_type, like tsdump -c writes them
 {
-	while( list != NULL )
+	fourcc bin_type = file_bin_type(file) ;
+	struct sample_codec *codec = find_sample_codec(bin_type) ;
+	if( codec == NULL )
 	{
-		if( list->data != NULL )
-			free(list->data) ;
-		struct node *next = list->next ;
-		free(list) ;
-		list = next ;
+		printf("Unknown bin_type '%s' (%x)\n",strkey(bin_type),bin_type) ;
+		return 1 ;
 	}
+	(*codec->load)(channel->data,2*channel->count,values) ;
+	return 0 ;
+}
+
+int ts_dump_text(struct ts_file *file, FILE *outfile, int compact)
+{
+	struct dump_options options ;
+	memset(&options,0,sizeof(struct dump_options)) ;
+	options.compact = compact ;
+	options.threads = 1 ;
+	return dump_list(file->root.next,outfile,&options) ;
+}
+
+int ts_write_binary(struct ts_file *file, FILE *outfile)
+{
+	return ts_write(file->root.next,outfile) ;
 }
 
 //END
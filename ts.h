@@ -0,0 +1,102 @@
+/*
+	libts: the parser and writer behind tsdump and tsgen, for programs that want to read CODAR Time Series (TS) files in process.
+	Build ts.c with TS_LIBRARY defined to leave out main(), see COMPILING in README.md.
+
+	A file is parsed once by ts_open() (binary) or ts_open_text() (tsdump text) into an opaque handle.
+	ts_walk() instead calls back for each block as it is parsed and keeps nothing, for a single pass over a large file.
+	Every value handed back is in host byte order. The alvl samples are not copied, they point into the parsed file and
+	stay valid until ts_close(). The functions return 0 or a pointer on success and 1 or NULL on error, after printing
+	a message to stdout like the utilities do.
+*/
+
+#ifndef TS_H
+#define TS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define TS_MAX_CHANNELS		8		// alvl blocks returned per sweep set
+#define TS_SIZE_KEY		5		// four characters and a terminator
+#define TS_SIZE_TEXT		65		// a sign text field and a terminator
+
+struct ts_file ;				// one parsed file
+
+struct ts_sign					// the 'sign' block
+{
+	char version[TS_SIZE_KEY] ;
+	char filetype[TS_SIZE_KEY] ;
+	char sitecode[TS_SIZE_KEY] ;
+	uint32_t userflags ;
+	char description[TS_SIZE_TEXT] ;
+	char ownername[TS_SIZE_TEXT] ;
+	char comment[TS_SIZE_TEXT] ;
+} ;
+
+struct ts_cnst					// the 'cnst' block
+{
+	int32_t nchannels ;
+	int32_t nsweeps ;
+	int32_t nsamples ;
+	int32_t iqindicator ;
+} ;
+
+struct ts_swep					// the 'swep' block
+{
+	int32_t samplespersweep ;
+	double sweepstart ;
+	double sweepbandwidth ;
+	double sweeprate ;
+	int32_t rangeoffset ;
+} ;
+
+struct ts_fbin					// the 'fbin' block
+{
+	char format[TS_SIZE_KEY] ;		// normally "cviq"
+	char type[TS_SIZE_KEY] ;		// "fix2", "fix3", "fix4" or "flt4"
+} ;
+
+struct ts_channel				// one alvl block
+{
+	const int16_t *samples ;		// I and Q interleaved, in host order, pointing into the parsed file, NULL unless the fbin type is fix2
+	size_t count ;				// I/Q pairs
+	const void *data ;			// the same for any fbin type: int16_t (fix2), 3 byte integers (fix3), int32_t (fix4) or float (flt4)
+	int width ;				// bytes per I or Q value in data
+} ;
+
+struct ts_sweep					// one sweep set, blocks it does not have are left zero
+{
+	uint32_t gtag ;
+	uint32_t atag ;
+	uint32_t index ;			// the 'indx' value
+	double scalar_one ;			// the 'scal' values
+	double scalar_two ;
+	int nchannels ;				// alvl blocks in the sweep set
+	struct ts_channel channel[TS_MAX_CHANNELS] ;
+} ;
+
+struct ts_events				// callbacks for ts_walk(), any can be NULL, a nonzero return stops the walk and is returned by it
+{
+	int (*enter)(void *user, uint32_t key, void *data, uint32_t size) ;	// a superblock (AQVL, HEAD, BODY, END) starts, its blocks follow
+	int (*leave)(void *user, uint32_t key) ;				// the blocks of the superblock are done
+	int (*block)(void *user, uint32_t key, void *data, uint32_t size) ;	// a data block, fixed up to host order, valid during the call
+	void *user ;								// passed to each callback
+} ;
+
+#define TS_KEY(text)	((uint32_t )(unsigned char )(text)[0]<<24 | (uint32_t )(unsigned char )(text)[1]<<16 | (uint32_t )(unsigned char )(text)[2]<<8 | (uint32_t )(unsigned char )(text)[3])	// TS_KEY("alvl") is the key of an alvl block
+
+struct ts_file *ts_open(const char *filename) ;			// parses a binary file
+struct ts_file *ts_open_text(const char *filename) ;		// parses text written by tsdump or ts_dump_text()
+void ts_close(struct ts_file *) ;
+int ts_get_sign(struct ts_file *, struct ts_sign *) ;
+int ts_get_cnst(struct ts_file *, struct ts_cnst *) ;
+int ts_get_swep(struct ts_file *, struct ts_swep *) ;
+int ts_get_fbin(struct ts_file *, struct ts_fbin *) ;
+size_t ts_sweep_count(struct ts_file *) ;
+int ts_get_sweep(struct ts_file *, size_t, struct ts_sweep *) ;	// sweep sets are counted from 0
+int ts_get_values(struct ts_file *, const struct ts_channel *, double *) ;	// the 2*count I/Q counts of a channel as doubles, for any fbin type
+int ts_dump_text(struct ts_file *, FILE *, int) ;		// writes what tsdump writes, or tsdump -c if the last argument is 1
+int ts_write_binary(struct ts_file *, FILE *) ;			// writes the binary file, as often as wanted
+int ts_walk(const char *filename, struct ts_events *) ;		// parses a binary file one block at a time without keeping anything
+
+#endif